@@ -7,7 +7,7 @@
 #include "CarController.generated.h"
 
 /**
- * 
+ * Registers the possessed vehicle with the UTrafficSimulationSubsystem which drives all cars in one pass.
  */
 UCLASS()
 class TRAFFICSYSTEM_API ACarController : public AAIController
@@ -15,28 +15,36 @@ class TRAFFICSYSTEM_API ACarController : public AAIController
 	GENERATED_BODY()
 
 public:
+	ACarController();
+
 	virtual void OnPossess(APawn* InPawn) override;
 	virtual void OnUnPossess() override;
 	virtual void BeginPlay() override;
-	virtual void Tick(float DeltaTime) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Plans a route from the current target waypoint to the lane closest to Location
+	UFUNCTION(BlueprintCallable, Category = "Driving")
+	bool SetDestination(const FVector& Location);
+
+	class AWheeledVehicle* GetPossessedVehicle() const;
+	int32 GetSimulationHandle() const;
 
-	bool CheckCollisions() const;
+	// Controllers of pooled vehicles are handed the handle of the virtual vehicle they currently represent
+	void AssignSimulationHandle(int32 Handle);
+
+	// Disabled for pooled controllers, their vehicle is managed by the simulation
+	UPROPERTY(EditAnywhere, Category = "Driving")
+	bool bRegisterWithSimulation;
 
 protected:
 	class AWheeledVehicle* PosessedVehicle;
 
 	UPROPERTY(VisibleAnywhere)
-	TWeakObjectPtr<class ALane> CurrentLane;
-	UPROPERTY(VisibleAnywhere)
-	int32 CurrentWaypointIndex;
-	
-	ALane* FindClosestLane(float Radius);
-	bool FindClosestWaypointIndex(TWeakObjectPtr<ALane>& OutLane, int32& OutWaypointIndex);
-	bool HasValidWaypoint() const;
+	int32 SimulationHandle;
 
-	static float CalculateTurnAngle(const FVector& VehicleLocation, const FVector& VehicleForward,
-									const FVector& TargetLocation);
+	void RegisterWithSimulation();
+	void UnregisterFromSimulation();
 
-	void Drive() const;
+	class ALane* FindClosestLane(float Radius);
+	bool FindClosestWaypointIndex(TWeakObjectPtr<class ALane>& OutLane, int32& OutWaypointIndex);
 };
-
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConnectionPriority.generated.h"
+
+// Right of way of a connection where it crosses or merges with others at junctions without signals
+UENUM(BlueprintType)
+enum class EConnectionPriority : uint8
+{
+	// Crossing traffic is served first come, first served
+	Normal,
+
+	// Served before normal connections, yield and stop connections wait for a gap in its traffic
+	PriorityRoad,
+
+	// Waits for a gap in the traffic of the normal and priority connections it crosses or merges with
+	Yield,
+
+	// Comes to a full stop, then waits for a gap like Yield
+	Stop
+};
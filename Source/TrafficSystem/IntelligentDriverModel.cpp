@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IntelligentDriverModel.h"
+
+namespace
+{
+	// Keeps the model finite for standing vehicles and overlapping gaps
+	constexpr float MinDesiredSpeed = 1.0f;
+	constexpr float MinGap = 1.0f;
+}
+
+float FIntelligentDriverModel::CalculateAcceleration(const float Speed, const float DesiredSpeed, const float Gap,
+													 const float ApproachingRate) const
+{
+	const float InteractionScale = 0.5f / FMath::Sqrt(MaxAcceleration * ComfortableDeceleration);
+
+	const float SpeedRatio = Speed / FMath::Max(DesiredSpeed, MinDesiredSpeed);
+	const float SpeedRatioSquared = SpeedRatio * SpeedRatio;
+
+	const float DesiredGap =
+		MinimumGap + FMath::Max(0.0f, Speed * TimeHeadway + Speed * ApproachingRate * InteractionScale);
+	const float GapRatio = DesiredGap / FMath::Max(Gap, MinGap);
+
+	const float Acceleration =
+		MaxAcceleration * (1.0f - SpeedRatioSquared * SpeedRatioSquared - GapRatio * GapRatio);
+	return FMath::Clamp(Acceleration, -MaxDeceleration, MaxAcceleration);
+}
+
+void FIntelligentDriverModel::CalculateAccelerations(const TArrayView<const float> Speeds,
+													 const TArrayView<const float> DesiredSpeeds,
+													 const TArrayView<const float> Gaps,
+													 const TArrayView<const float> ApproachingRates,
+													 TArrayView<float> OutAccelerations) const
+{
+	check(Speeds.Num() == OutAccelerations.Num() && DesiredSpeeds.Num() == OutAccelerations.Num());
+	check(Gaps.Num() == OutAccelerations.Num() && ApproachingRates.Num() == OutAccelerations.Num());
+
+	for (int32 Index = 0; Index < OutAccelerations.Num(); ++Index)
+	{
+		OutAccelerations[Index] = CalculateAcceleration(Speeds[Index], DesiredSpeeds[Index], Gaps[Index],
+														ApproachingRates[Index]);
+	}
+}
+
+void FIntelligentDriverModel::CalculateInputs(const TArrayView<const float> Accelerations,
+											  TArrayView<float> OutThrottle, TArrayView<float> OutBrake) const
+{
+	check(OutThrottle.Num() == Accelerations.Num() && OutBrake.Num() == Accelerations.Num());
+
+	for (int32 Index = 0; Index < Accelerations.Num(); ++Index)
+	{
+		const float Acceleration = Accelerations[Index];
+		OutThrottle[Index] = FMath::Clamp(Acceleration / MaxAcceleration, 0.0f, 1.0f);
+		OutBrake[Index] =
+			FMath::Clamp((-Acceleration - CoastDeceleration) / (MaxDeceleration - CoastDeceleration), 0.0f, 1.0f);
+	}
+}
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Intelligent Driver Model car-following controller. The acceleration blends free road acceleration towards
+ * the desired speed with braking to keep a safe, speed dependent gap to the obstacle ahead:
+ *
+ *   a = MaxAcceleration * (1 - (v / v0)^4 - (s* / s)^2)
+ *   s* = MinimumGap + v * TimeHeadway + v * dv / (2 * sqrt(MaxAcceleration * ComfortableDeceleration))
+ *
+ * All units are centimeters and seconds. The batch functions work on parallel arrays without branches so the
+ * compiler can vectorize them.
+ */
+struct TRAFFICSYSTEM_API FIntelligentDriverModel
+{
+	float MaxAcceleration = 200.0f;
+	float ComfortableDeceleration = 300.0f;
+
+	// Strongest deceleration the model asks for, mapped to full brake input
+	float MaxDeceleration = 900.0f;
+
+	// Bumper to bumper distance kept when standing
+	float MinimumGap = 200.0f;
+	float TimeHeadway = 1.5f;
+
+	// Decelerations below this are left to rolling resistance instead of the brakes
+	float CoastDeceleration = 50.0f;
+
+	// Acceleration for one vehicle. Gap is bumper to bumper, ApproachingRate is own speed minus leader speed.
+	float CalculateAcceleration(float Speed, float DesiredSpeed, float Gap, float ApproachingRate) const;
+
+	void CalculateAccelerations(TArrayView<const float> Speeds, TArrayView<const float> DesiredSpeeds,
+								TArrayView<const float> Gaps, TArrayView<const float> ApproachingRates,
+								TArrayView<float> OutAccelerations) const;
+
+	// Maps accelerations to throttle and brake inputs of the vehicle movement
+	void CalculateInputs(TArrayView<const float> Accelerations, TArrayView<float> OutThrottle,
+						 TArrayView<float> OutBrake) const;
+};
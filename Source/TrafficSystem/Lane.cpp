@@ -5,6 +5,13 @@
 
 #include "DrawDebugHelpers.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "LaneGraph.h"
+
+namespace
+{
+	// Drawn splines need less detail than the ones vehicles follow
+	constexpr float DrawSplineTolerance = 25.0f;
+}
 
 // Sets default values
 ALane::ALane()
@@ -12,6 +19,9 @@ ALane::ALane()
 	SceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneComponent"));
 	SetRootComponent(SceneComponent);
 
+	VehicleDensity = -1.0f;
+	bSpline = false;
+
 	#if WITH_EDITOR
 		// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 		PrimaryActorTick.bCanEverTick = true;
@@ -74,11 +84,47 @@ FVector ALane::GetWaypointDirection(int32 WaypointIndex) const
 	if (GetWaypoints().Num() == 1 || !HasWaypointAt(WaypointIndex))
 		return FVector::ForwardVector;
 
+	if (bSpline)
+	{
+		TArray<FVector> Locations;
+		TArray<FVector> Tangents;
+		GatherSplinePoints(Locations, Tangents);
+		return FLaneGraph::CalculateSplineTangent(Locations, Tangents, WaypointIndex).GetSafeNormal();
+	}
+
 	// Last Waypoint get the same direction as previous
-	if (WaypointIndex == GetWaypoints().Num() - 1)
-		return GetWaypointDirection(WaypointIndex - 1);
+	const int32 FromIndex = FMath::Min(WaypointIndex, GetWaypoints().Num() - 2);
+	return (Waypoints[FromIndex + 1].Location - Waypoints[FromIndex].Location).GetSafeNormal();
+}
+
+void ALane::TessellateLane(TArray<FVector>& OutPoints, TArray<int32>& OutWaypointPoints) const
+{
+	TArray<FVector> Locations;
+	TArray<FVector> Tangents;
+	GatherSplinePoints(Locations, Tangents);
+	if (bSpline)
+	{
+		FLaneGraph::TessellateSpline(Locations, Tangents, DrawSplineTolerance, OutPoints, OutWaypointPoints);
+		return;
+	}
 
-	return (GetWaypointByIndex(WaypointIndex + 1).Location - GetWaypointByIndex(WaypointIndex).Location).GetSafeNormal();
+	OutPoints = MoveTemp(Locations);
+	OutWaypointPoints.Reset(OutPoints.Num());
+	for (int32 Index = 0; Index < OutPoints.Num(); ++Index)
+	{
+		OutWaypointPoints.Add(Index);
+	}
+}
+
+void ALane::GatherSplinePoints(TArray<FVector>& OutLocations, TArray<FVector>& OutTangents) const
+{
+	OutLocations.Reset(Waypoints.Num());
+	OutTangents.Reset(Waypoints.Num());
+	for (const FWaypoint& Waypoint : Waypoints)
+	{
+		OutLocations.Add(Waypoint.Location);
+		OutTangents.Add(Waypoint.Tangent);
+	}
 }
 
 void ALane::SetStop(const int32 Index, const bool bStopFlag)
@@ -115,12 +161,24 @@ bool ALane::ShouldTickIfViewportsOnly() const
 #if WITH_EDITOR
 void ALane::DebugDrawLane()
 {
+	TArray<FVector> Points;
+	TArray<int32> WaypointPoints;
+	if (bSpline)
+		TessellateLane(Points, WaypointPoints);
+
 	for (int32 i = 0; i < Waypoints.Num(); i++)
 	{
 		DrawDebugPoint(GetWorld(), Waypoints[i].Location, 25.f, FColor::Green);
 
 		// Draw Waypoints
-		if (i > 0)
+		if (i > 0 && bSpline)
+		{
+			for (int32 Point = WaypointPoints[i - 1]; Point < WaypointPoints[i]; ++Point)
+			{
+				DrawDebugLine(GetWorld(), Points[Point], Points[Point + 1], FColor::Green);
+			}
+		}
+		else if (i > 0)
 		{
 			FVector StartLocation = Waypoints[i - 1].Location;
 			FVector EndLocation = Waypoints[i].Location;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "ConnectionPriority.h"
 #include "GameFramework/Actor.h"
 #include "Lane.generated.h"
 
@@ -15,6 +16,10 @@ struct FConnection
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	int32 Id;
 
+	// Right of way of outgoing connections, unused on incoming ones
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EConnectionPriority Priority = EConnectionPriority::Normal;
+
 	FConnection() = default;
 	
 	FConnection(const TWeakObjectPtr<class ALane>& InLane, const int32 InId)
@@ -45,7 +50,12 @@ struct FWaypoint
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Info")
 	FVector Location;
 
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Info")
+	// Spline tangent on spline lanes, zero for a tangent from the neighbouring waypoints
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spline")
+	FVector Tangent;
+
+	// Only the priority of the connections can be edited, connecting goes through the lane editor
+	UPROPERTY(EditAnywhere, EditFixedSize, BlueprintReadOnly, Category = "Info")
 	TArray<FConnection> OutConnections;
 	
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Info")
@@ -58,6 +68,7 @@ struct FWaypoint
 	, Stop(false)
 	, TargetSpeed(InTargetSpeed)
 	, Location(std::move(InLocation))
+	, Tangent(FVector::ZeroVector)
 	{}
 };
 
@@ -76,6 +87,15 @@ public:
 		UPROPERTY(EditAnywhere)
 		bool DrawDebugEnabled;		
 	#endif
+
+	// Vehicles per kilometer the traffic spawner keeps on this lane, negative uses the project default
+	UPROPERTY(EditInstanceOnly, BlueprintReadWrite, Category = "Spawning")
+	float VehicleDensity;
+
+	// Interpolates the waypoints with a spline through their tangents instead of straight segments, so curves need
+	// few waypoints. The lane graph samples the spline when it is built.
+	UPROPERTY(EditInstanceOnly, BlueprintReadWrite, Category = "Waypoints")
+	bool bSpline;
 	
 	// AActor overrides
 	virtual void PostActorCreated() override;
@@ -103,6 +123,10 @@ public:
 	void SetWaypointLocation(int32 Index, const FVector& Location);
 	
 	FVector GetWaypointDirection(int32 Index) const;
+
+	// Waypoint locations with the sampled spline between them on spline lanes, OutWaypointPoints holds the index
+	// of the point of every waypoint
+	void TessellateLane(TArray<FVector>& OutPoints, TArray<int32>& OutWaypointPoints) const;
 	
 protected:
 	virtual bool ShouldTickIfViewportsOnly() const override;
@@ -133,6 +157,7 @@ private:
 	FWaypoint CreateWaypoint(FVector Location = FVector(), float Speed = 50.0f);
 	
 	int32 CalculateNextWaypointId() const;
+	void GatherSplinePoints(TArray<FVector>& OutLocations, TArray<FVector>& OutTangents) const;
 	void RebuildWaypointMap();
 };
 
@@ -0,0 +1,807 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaneGraph.h"
+
+#include "Algo/BinarySearch.h"
+#include "EngineUtils.h"
+#include "Lane.h"
+
+namespace
+{
+	// Keeps travel costs finite for waypoints with a target speed of zero
+	constexpr float MinCostSpeed = 1.0f;
+
+	// FWaypoint::TargetSpeed is given in km/h
+	constexpr float KilometersPerHourToCentimetersPerSecond = 100000.0f / 3600.0f;
+
+	// Speed profiles: comfortable lateral acceleration in curves and deceleration ahead of slower nodes, in cm/s^2
+	constexpr float CurveLateralAcceleration = 250.0f;
+	constexpr float SpeedProfileDeceleration = 200.0f;
+
+	// Turns are spread over at least this length, waypoints at the same place do not make a sharp curve
+	constexpr float MinCurveLength = 100.0f;
+
+	float CalculateCurveSpeed(const float Curvature)
+	{
+		return FMath::Abs(Curvature) > SMALL_NUMBER ? FMath::Sqrt(CurveLateralAcceleration / FMath::Abs(Curvature))
+													: MAX_FLT;
+	}
+
+	// Signed angle from one 2D direction to another, positive turning right
+	float CalculateTurnAngle(const FVector& From, const FVector& To)
+	{
+		return FMath::Atan2(From.X * To.Y - From.Y * To.X, From.X * To.X + From.Y * To.Y);
+	}
+
+	// Splines are sampled until the curve is within this distance of the shape, a segment is split at most this
+	// many times
+	constexpr float SplineTolerance = 10.0f;
+	constexpr int32 MaxSplineSubdivisions = 6;
+
+	struct FHermiteSegment
+	{
+		FVector Start;
+		FVector StartTangent;
+		FVector End;
+		FVector EndTangent;
+
+		FVector Evaluate(const float Alpha) const
+		{
+			return FMath::CubicInterp(Start, StartTangent, End, EndTangent, Alpha);
+		}
+	};
+
+	// Appends the points strictly between the parameters A and B, split where the curve leaves the chord
+	void TessellateSegment(const FHermiteSegment& Segment, const float A, const float B, const FVector& PointA,
+						   const FVector& PointB, const float Tolerance, const int32 Depth, TArray<FVector>& OutPoints)
+	{
+		if (Depth >= MaxSplineSubdivisions)
+			return;
+
+		// The midpoint alone misses S-curves crossing the chord in the middle
+		const float Mid = 0.5f * (A + B);
+		const FVector PointMid = Segment.Evaluate(Mid);
+		const bool bFlat =
+			FMath::PointDistToSegment(PointMid, PointA, PointB) < Tolerance &&
+			FMath::PointDistToSegment(Segment.Evaluate(0.5f * (A + Mid)), PointA, PointB) < Tolerance &&
+			FMath::PointDistToSegment(Segment.Evaluate(0.5f * (Mid + B)), PointA, PointB) < Tolerance;
+		if (bFlat)
+			return;
+
+		TessellateSegment(Segment, A, Mid, PointA, PointMid, Tolerance, Depth + 1, OutPoints);
+		OutPoints.Add(PointMid);
+		TessellateSegment(Segment, Mid, B, PointMid, PointB, Tolerance, Depth + 1, OutPoints);
+	}
+
+	// Edges are sorted into cells of this size to find crossings, crossings further apart in height are bridges
+	constexpr float ConflictCellSize = 2000.0f;
+	constexpr float ConflictMaxHeight = 300.0f;
+
+	FIntPoint GetConflictCell(const FVector& Location)
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X / ConflictCellSize),
+						 FMath::FloorToInt(Location.Y / ConflictCellSize));
+	}
+
+	// Points an edge follows: the shape of the lane between neighbouring nodes, a straight line otherwise
+	using FEdgeShape = TArray<FVector, TInlineAllocator<16>>;
+
+	void GatherEdgeShape(const FLaneGraph& Graph, const int32 FromNode, const int32 ToNode, FEdgeShape& OutPoints)
+	{
+		OutPoints.Reset();
+		if (ToNode == FromNode + 1 && Graph.NodeLanes[FromNode] == Graph.NodeLanes[ToNode])
+		{
+			for (int32 Point = Graph.NodeShapePoints[FromNode]; Point <= Graph.NodeShapePoints[ToNode]; ++Point)
+			{
+				OutPoints.Add(Graph.ShapePositions[Point]);
+			}
+			return;
+		}
+
+		OutPoints.Add(Graph.Positions[FromNode]);
+		OutPoints.Add(Graph.Positions[ToNode]);
+	}
+
+	float CalculateLength2D(const FEdgeShape& Points)
+	{
+		float Length = 0.0f;
+		for (int32 Point = 1; Point < Points.Num(); ++Point)
+		{
+			Length += FVector::Dist2D(Points[Point - 1], Points[Point]);
+		}
+		return Length;
+	}
+
+	// First crossing of two edges along the first one as 2D distances along their shapes, edges sharing their source
+	// or following each other do not conflict
+	bool FindConflict(const FLaneGraph& Graph, const int32 FromA, const int32 ToA, const int32 FromB, const int32 ToB,
+					  float& OutDistanceA, float& OutDistanceB)
+	{
+		if (FromA == FromB || FromA == ToB || ToA == FromB)
+			return false;
+
+		FEdgeShape ShapeA;
+		FEdgeShape ShapeB;
+		GatherEdgeShape(Graph, FromA, ToA, ShapeA);
+		GatherEdgeShape(Graph, FromB, ToB, ShapeB);
+		if (ToA == ToB)
+		{
+			OutDistanceA = CalculateLength2D(ShapeA);
+			OutDistanceB = CalculateLength2D(ShapeB);
+			return true;
+		}
+
+		float DistanceA = 0.0f;
+		for (int32 PointA = 1; PointA < ShapeA.Num(); ++PointA)
+		{
+			const FVector StartA(ShapeA[PointA - 1].X, ShapeA[PointA - 1].Y, 0.0f);
+			const FVector EndA(ShapeA[PointA].X, ShapeA[PointA].Y, 0.0f);
+			const float LengthA = FVector::Dist(StartA, EndA);
+			float DistanceB = 0.0f;
+			for (int32 PointB = 1; PointB < ShapeB.Num(); ++PointB)
+			{
+				const FVector StartB(ShapeB[PointB - 1].X, ShapeB[PointB - 1].Y, 0.0f);
+				const FVector EndB(ShapeB[PointB].X, ShapeB[PointB].Y, 0.0f);
+				const float LengthB = FVector::Dist(StartB, EndB);
+				FVector Crossing;
+				if (FMath::SegmentIntersection2D(StartA, EndA, StartB, EndB, Crossing))
+				{
+					const float AlongA = FVector::Dist(StartA, Crossing);
+					const float AlongB = FVector::Dist(StartB, Crossing);
+					const float HeightA = FMath::Lerp(ShapeA[PointA - 1].Z, ShapeA[PointA].Z,
+													  AlongA / FMath::Max(LengthA, KINDA_SMALL_NUMBER));
+					const float HeightB = FMath::Lerp(ShapeB[PointB - 1].Z, ShapeB[PointB].Z,
+													  AlongB / FMath::Max(LengthB, KINDA_SMALL_NUMBER));
+					if (FMath::Abs(HeightA - HeightB) < ConflictMaxHeight)
+					{
+						OutDistanceA = DistanceA + AlongA;
+						OutDistanceB = DistanceB + AlongB;
+						return true;
+					}
+				}
+				DistanceB += LengthB;
+			}
+			DistanceA += LengthA;
+		}
+		return false;
+	}
+
+	void FindEdgeConflicts(FLaneGraph& Graph)
+	{
+		const int32 NumEdges = Graph.OutTargets.Num();
+		const TArray<int32>& EdgeSources = Graph.OutSources;
+
+		// Every edge goes into the cells of the bounds of its shape
+		TMap<FIntPoint, TArray<int32>> Cells;
+		TArray<FBox> EdgeBounds;
+		EdgeBounds.Reserve(NumEdges);
+		FEdgeShape Shape;
+		for (int32 Edge = 0; Edge < NumEdges; ++Edge)
+		{
+			GatherEdgeShape(Graph, EdgeSources[Edge], Graph.OutTargets[Edge], Shape);
+			const FBox& Bounds = EdgeBounds.Add_GetRef(FBox(Shape.GetData(), Shape.Num()));
+			const FIntPoint MinCell = GetConflictCell(Bounds.Min);
+			const FIntPoint MaxCell = GetConflictCell(Bounds.Max);
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+			{
+				for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+				{
+					Cells.FindOrAdd(FIntPoint(X, Y)).Add(Edge);
+				}
+			}
+		}
+
+		TArray<TArray<int32>> EdgeConflicts;
+		TArray<TArray<FVector2D>> EdgeConflictDistances;
+		EdgeConflicts.SetNum(NumEdges);
+		EdgeConflictDistances.SetNum(NumEdges);
+		for (const TPair<FIntPoint, TArray<int32>>& Cell : Cells)
+		{
+			const TArray<int32>& CellEdges = Cell.Value;
+			for (int32 I = 0; I < CellEdges.Num(); ++I)
+			{
+				const int32 EdgeA = CellEdges[I];
+				const int32 FromA = EdgeSources[EdgeA];
+				const int32 ToA = Graph.OutTargets[EdgeA];
+				for (int32 J = I + 1; J < CellEdges.Num(); ++J)
+				{
+					const int32 EdgeB = CellEdges[J];
+					const int32 FromB = EdgeSources[EdgeB];
+					const int32 ToB = Graph.OutTargets[EdgeB];
+
+					// Edges sharing several cells are tested in the cell at the lower corner of their common bounds
+					const FVector OverlapMin = EdgeBounds[EdgeA].Min.ComponentMax(EdgeBounds[EdgeB].Min);
+					if (GetConflictCell(OverlapMin) != Cell.Key)
+						continue;
+
+					float DistanceA;
+					float DistanceB;
+					if (!FindConflict(Graph, FromA, ToA, FromB, ToB, DistanceA, DistanceB))
+						continue;
+
+					EdgeConflicts[EdgeA].Add(EdgeB);
+					EdgeConflictDistances[EdgeA].Add(FVector2D(DistanceA, DistanceB));
+					EdgeConflicts[EdgeB].Add(EdgeA);
+					EdgeConflictDistances[EdgeB].Add(FVector2D(DistanceB, DistanceA));
+				}
+			}
+		}
+
+		Graph.ConflictOffsets.SetNumUninitialized(NumEdges + 1);
+		for (int32 Edge = 0; Edge < NumEdges; ++Edge)
+		{
+			Graph.ConflictOffsets[Edge] = Graph.ConflictEdges.Num();
+			Graph.ConflictEdges.Append(EdgeConflicts[Edge]);
+			for (const FVector2D& Distances : EdgeConflictDistances[Edge])
+			{
+				Graph.ConflictDistances.Add(Distances.X);
+				Graph.ConflictOtherDistances.Add(Distances.Y);
+			}
+		}
+		Graph.ConflictOffsets[NumEdges] = Graph.ConflictEdges.Num();
+	}
+
+	// Segment of Distances containing Distance and the fraction of the way through it, clamped to both ends
+	void FindSegment(const TArrayView<const float> Distances, const float Distance, int32& OutIndex, float& OutAlpha)
+	{
+		const int32 Next = Algo::UpperBound(Distances, Distance);
+		OutIndex = FMath::Max(Next - 1, 0);
+		OutAlpha = 0.0f;
+
+		// The upper bound is strictly beyond Distance, so the segment has a length
+		if (Next > 0 && Next < Distances.Num())
+			OutAlpha = (Distance - Distances[Next - 1]) / (Distances[Next] - Distances[Next - 1]);
+	}
+
+	// Length of the shape between two points of a lane in 3D, like the straight edges and EstimateCost, so the
+	// estimate stays below the cost on ramps
+	float CalculateShapeLength(const FLaneGraph& Graph, const int32 FromPoint, const int32 ToPoint)
+	{
+		float Length = 0.0f;
+		for (int32 Point = FromPoint + 1; Point <= ToPoint; ++Point)
+		{
+			Length += FVector::Dist(Graph.ShapePositions[Point - 1], Graph.ShapePositions[Point]);
+		}
+		return Length;
+	}
+
+	float CalculateShapeCurvature(const FLaneGraph& Graph, const int32 Point, const int32 FirstPoint,
+								  const int32 EndPoint)
+	{
+		if (Point == FirstPoint || Point + 1 >= EndPoint)
+			return 0.0f;
+
+		const FVector In = Graph.ShapePositions[Point] - Graph.ShapePositions[Point - 1];
+		const FVector Out = Graph.ShapePositions[Point + 1] - Graph.ShapePositions[Point];
+		const FVector InDirection = In.GetSafeNormal2D();
+		const FVector OutDirection = Out.GetSafeNormal2D();
+		if (InDirection.IsZero() || OutDirection.IsZero())
+			return 0.0f;
+
+		const float CurveLength = FMath::Max(0.5f * (In.Size2D() + Out.Size2D()), MinCurveLength);
+		return CalculateTurnAngle(InDirection, OutDirection) / CurveLength;
+	}
+
+	void BakeLaneGeometry(FLaneGraph& Graph)
+	{
+		const int32 NumNodes = Graph.GetNumNodes();
+		Graph.ShapeTangents.SetNumUninitialized(Graph.ShapePositions.Num());
+		Graph.Tangents.SetNumUninitialized(NumNodes);
+		Graph.Curvatures.SetNumUninitialized(NumNodes);
+		Graph.SpeedLimits.SetNumUninitialized(NumNodes);
+
+		for (int32 Lane = 0; Lane < Graph.GetNumLanes(); ++Lane)
+		{
+			const int32 FirstPoint = Graph.LaneFirstShapePoints[Lane];
+			const int32 EndPoint = Graph.LaneFirstShapePoints[Lane + 1];
+			for (int32 Point = FirstPoint; Point < EndPoint; ++Point)
+			{
+				const FVector InDirection = Point > FirstPoint
+					? (Graph.ShapePositions[Point] - Graph.ShapePositions[Point - 1]).GetSafeNormal2D()
+					: FVector::ZeroVector;
+				const FVector OutDirection = Point + 1 < EndPoint
+					? (Graph.ShapePositions[Point + 1] - Graph.ShapePositions[Point]).GetSafeNormal2D()
+					: FVector::ZeroVector;
+
+				// The tangent halves the turn at the point, ends of the lane follow their only segment
+				FVector Tangent = (InDirection + OutDirection).GetSafeNormal2D();
+				if (Tangent.IsZero())
+					Tangent = !OutDirection.IsZero() ? OutDirection : InDirection;
+				if (Tangent.IsZero())
+					Tangent = FVector::ForwardVector;
+
+				Graph.ShapeTangents[Point] = Tangent;
+			}
+
+			// A node takes the sharpest curvature of the shape points from halfway to the previous node to halfway
+			// to the next one, the node alone on straight segments
+			const int32 FirstNode = Graph.LaneFirstNodes[Lane];
+			const int32 EndNode = FirstNode + Graph.LaneNumNodes[Lane];
+			for (int32 Node = FirstNode; Node < EndNode; ++Node)
+			{
+				const int32 NodePoint = Graph.NodeShapePoints[Node];
+				const int32 WindowStart =
+					Node > FirstNode ? (Graph.NodeShapePoints[Node - 1] + NodePoint + 1) / 2 : NodePoint;
+				const int32 WindowEnd =
+					Node + 1 < EndNode ? (NodePoint + Graph.NodeShapePoints[Node + 1]) / 2 : NodePoint;
+
+				float Curvature = 0.0f;
+				for (int32 Point = WindowStart; Point <= WindowEnd; ++Point)
+				{
+					const float PointCurvature = CalculateShapeCurvature(Graph, Point, FirstPoint, EndPoint);
+					if (FMath::Abs(PointCurvature) > FMath::Abs(Curvature))
+						Curvature = PointCurvature;
+				}
+
+				Graph.Tangents[Node] = Graph.ShapeTangents[NodePoint];
+				Graph.Curvatures[Node] = Curvature;
+				Graph.SpeedLimits[Node] = FMath::Min(
+					Graph.TargetSpeeds[Node] * KilometersPerHourToCentimetersPerSecond, CalculateCurveSpeed(Curvature));
+			}
+		}
+
+		// Connections between lanes turn from the tangent at the lane end to the tangent at the next lane. Without
+		// knowing the branch of a vehicle the ends of the connections are limited by the fastest way through.
+		TArray<float> MaxInSpeeds;
+		TArray<float> MaxOutSpeeds;
+		MaxInSpeeds.Init(-1.0f, NumNodes);
+		MaxOutSpeeds.Init(-1.0f, NumNodes);
+		Graph.OutSpeedLimits.SetNumUninitialized(Graph.OutTargets.Num());
+		for (int32 Node = 0; Node < NumNodes; ++Node)
+		{
+			for (int32 Edge = Graph.OutOffsets[Node]; Edge < Graph.OutOffsets[Node + 1]; ++Edge)
+			{
+				const int32 ToNode = Graph.OutTargets[Edge];
+				const float CurveLength =
+					FMath::Max(FVector::Dist2D(Graph.Positions[Node], Graph.Positions[ToNode]), MinCurveLength);
+				const float Speed =
+					CalculateCurveSpeed(CalculateTurnAngle(Graph.Tangents[Node], Graph.Tangents[ToNode]) / CurveLength);
+				Graph.OutSpeedLimits[Edge] = Speed;
+
+				if (Graph.NodeLanes[ToNode] != Graph.NodeLanes[Node])
+				{
+					MaxOutSpeeds[Node] = FMath::Max(MaxOutSpeeds[Node], Speed);
+					MaxInSpeeds[ToNode] = FMath::Max(MaxInSpeeds[ToNode], Speed);
+				}
+			}
+		}
+
+		for (int32 Lane = 0; Lane < Graph.GetNumLanes(); ++Lane)
+		{
+			const int32 FirstNode = Graph.LaneFirstNodes[Lane];
+			const int32 LastNode = FirstNode + Graph.LaneNumNodes[Lane] - 1;
+			for (int32 Node = FirstNode; Node <= LastNode; ++Node)
+			{
+				if (MaxInSpeeds[Node] >= 0.0f)
+					Graph.SpeedLimits[Node] = FMath::Min(Graph.SpeedLimits[Node], MaxInSpeeds[Node]);
+				if (MaxOutSpeeds[Node] >= 0.0f)
+					Graph.SpeedLimits[Node] = FMath::Min(Graph.SpeedLimits[Node], MaxOutSpeeds[Node]);
+			}
+
+			// Brake ahead of slower nodes: v^2 = v_next^2 + 2 * a * d
+			for (int32 Node = LastNode - 1; Node >= FirstNode; --Node)
+			{
+				const float Distance = Graph.NodeDistances[Node + 1] - Graph.NodeDistances[Node];
+				const float ReachableSpeed = FMath::Sqrt(FMath::Square(Graph.SpeedLimits[Node + 1]) +
+														 2.0f * SpeedProfileDeceleration * Distance);
+				Graph.SpeedLimits[Node] = FMath::Min(Graph.SpeedLimits[Node], ReachableSpeed);
+			}
+		}
+	}
+}
+
+int32 FLaneGraph::GetNumNodes() const
+{
+	return Positions.Num();
+}
+
+int32 FLaneGraph::GetNumLanes() const
+{
+	return LaneFirstNodes.Num();
+}
+
+bool FLaneGraph::IsValidNode(const int32 Node) const
+{
+	return Positions.IsValidIndex(Node);
+}
+
+int32 FLaneGraph::GetNodeIndex(const int32 LaneIndex, const int32 WaypointIndex) const
+{
+	check(LaneFirstNodes.IsValidIndex(LaneIndex));
+	check(WaypointIndex >= 0 && WaypointIndex < LaneNumNodes[LaneIndex]);
+
+	return LaneFirstNodes[LaneIndex] + WaypointIndex;
+}
+
+int32 FLaneGraph::GetWaypointIndex(const int32 Node) const
+{
+	check(IsValidNode(Node));
+
+	return Node - LaneFirstNodes[NodeLanes[Node]];
+}
+
+void FLaneGraph::FindLaneSegment(const int32 LaneIndex, const float Distance, int32& OutNode, float& OutAlpha) const
+{
+	check(LaneFirstNodes.IsValidIndex(LaneIndex) && LaneNumNodes[LaneIndex] > 0);
+
+	const int32 FirstNode = LaneFirstNodes[LaneIndex];
+	FindSegment(MakeArrayView(NodeDistances.GetData() + FirstNode, LaneNumNodes[LaneIndex]), Distance, OutNode,
+				OutAlpha);
+	OutNode += FirstNode;
+}
+
+FVector FLaneGraph::CalculateLanePoint(const int32 LaneIndex, const float Distance) const
+{
+	check(LaneFirstNodes.IsValidIndex(LaneIndex) && LaneNumNodes[LaneIndex] > 0);
+
+	const int32 FirstPoint = LaneFirstShapePoints[LaneIndex];
+	int32 Point;
+	float Alpha;
+	FindSegment(MakeArrayView(ShapeDistances.GetData() + FirstPoint, LaneFirstShapePoints[LaneIndex + 1] - FirstPoint),
+				Distance, Point, Alpha);
+	Point += FirstPoint;
+	return Alpha > 0.0f ? FMath::Lerp(ShapePositions[Point], ShapePositions[Point + 1], Alpha) : ShapePositions[Point];
+}
+
+float FLaneGraph::CalculateSpeedLimit(const int32 LaneIndex, const float Distance) const
+{
+	int32 Node;
+	float Alpha;
+	FindLaneSegment(LaneIndex, Distance, Node, Alpha);
+	return Alpha > 0.0f ? FMath::Lerp(SpeedLimits[Node], SpeedLimits[Node + 1], Alpha) : SpeedLimits[Node];
+}
+
+int32 FLaneGraph::FindNextShapePoint(const int32 FromNode, const int32 Node, const FVector& Location) const
+{
+	// Only the segment from the node before on the same lane has shape points in between
+	const int32 NodePoint = NodeShapePoints[Node];
+	if (FromNode != Node - 1 || Node == LaneFirstNodes[NodeLanes[Node]])
+		return NodePoint;
+
+	// Points are passed once the vehicle is beyond them in the direction of the segment leading to them
+	for (int32 Point = NodeShapePoints[Node - 1] + 1; Point < NodePoint; ++Point)
+	{
+		const FVector& Position = ShapePositions[Point];
+		if (FVector::DotProduct(Position - Location, Position - ShapePositions[Point - 1]) > 0.0f)
+			return Point;
+	}
+	return NodePoint;
+}
+
+int32 FLaneGraph::GetNumOutEdges(const int32 Node) const
+{
+	return OutOffsets[Node + 1] - OutOffsets[Node];
+}
+
+int32 FLaneGraph::GetOutEdge(const int32 Node, const int32 EdgeIndex) const
+{
+	check(EdgeIndex >= 0 && EdgeIndex < GetNumOutEdges(Node));
+
+	return OutTargets[OutOffsets[Node] + EdgeIndex];
+}
+
+TArrayView<const int32> FLaneGraph::GetOutEdges(const int32 Node) const
+{
+	return MakeArrayView(OutTargets.GetData() + OutOffsets[Node], GetNumOutEdges(Node));
+}
+
+TArrayView<const int32> FLaneGraph::GetInEdges(const int32 Node) const
+{
+	return MakeArrayView(InSources.GetData() + InOffsets[Node], InOffsets[Node + 1] - InOffsets[Node]);
+}
+
+int32 FLaneGraph::FindEdge(const int32 FromNode, const int32 ToNode) const
+{
+	for (int32 Edge = OutOffsets[FromNode]; Edge < OutOffsets[FromNode + 1]; ++Edge)
+	{
+		if (OutTargets[Edge] == ToNode)
+			return Edge;
+	}
+	return INDEX_NONE;
+}
+
+int32 FLaneGraph::GetNumConflicts(const int32 Edge) const
+{
+	return ConflictOffsets[Edge + 1] - ConflictOffsets[Edge];
+}
+
+float FLaneGraph::EstimateCost(const int32 FromNode, const int32 ToNode) const
+{
+	return FVector::Dist(Positions[FromNode], Positions[ToNode]) / MaxTargetSpeed;
+}
+
+uint32 FLaneGraph::CalculateChecksum() const
+{
+	uint32 Checksum = FCrc::MemCrc32(OutOffsets.GetData(), OutOffsets.Num() * OutOffsets.GetTypeSize());
+	Checksum = FCrc::MemCrc32(OutTargets.GetData(), OutTargets.Num() * OutTargets.GetTypeSize(), Checksum);
+	Checksum = FCrc::MemCrc32(OutCosts.GetData(), OutCosts.Num() * OutCosts.GetTypeSize(), Checksum);
+	return Checksum;
+}
+
+void FLaneGraph::Reset()
+{
+	Positions.Reset();
+	TargetSpeeds.Reset();
+	StopFlags.Reset();
+	NodeLanes.Reset();
+	NodeDistances.Reset();
+	ShapePositions.Reset();
+	ShapeDistances.Reset();
+	ShapeTangents.Reset();
+	LaneFirstShapePoints.Reset();
+	NodeShapePoints.Reset();
+	Tangents.Reset();
+	Curvatures.Reset();
+	SpeedLimits.Reset();
+	OutOffsets.Reset();
+	OutTargets.Reset();
+	OutLengths.Reset();
+	OutCosts.Reset();
+	OutSpeedLimits.Reset();
+	OutSources.Reset();
+	OutPriorities.Reset();
+	ConflictOffsets.Reset();
+	ConflictEdges.Reset();
+	ConflictDistances.Reset();
+	ConflictOtherDistances.Reset();
+	InOffsets.Reset();
+	InSources.Reset();
+	InCosts.Reset();
+	LaneFirstNodes.Reset();
+	LaneNumNodes.Reset();
+	MaxTargetSpeed = 0.0f;
+}
+
+void FLaneGraph::GatherLanes(UWorld* World, TArray<ALane*>& OutLanes)
+{
+	OutLanes.Reset();
+	for (TActorIterator<ALane> It(World); It; ++It)
+	{
+		if (IsValid(*It))
+			OutLanes.Add(*It);
+	}
+
+	// Actor iteration order is not stable, sort to get the same node indices on every run
+	OutLanes.Sort([](const ALane& A, const ALane& B)
+	{
+		return A.GetPathName() < B.GetPathName();
+	});
+}
+
+void FLaneGraph::Build(const TArray<ALane*>& Lanes, FLaneGraph& OutGraph)
+{
+	TArray<FLaneGraphLane> LaneDescs;
+	DescribeLanes(Lanes, LaneDescs);
+	Build(LaneDescs, OutGraph);
+}
+
+void FLaneGraph::DescribeLanes(const TArray<ALane*>& Lanes, TArray<FLaneGraphLane>& OutLanes)
+{
+	TMap<const ALane*, int32> LaneIndices;
+	LaneIndices.Reserve(Lanes.Num());
+	for (int32 LaneIndex = 0; LaneIndex < Lanes.Num(); ++LaneIndex)
+	{
+		LaneIndices.Add(Lanes[LaneIndex], LaneIndex);
+	}
+
+	OutLanes.Reset(Lanes.Num());
+	for (const ALane* Lane : Lanes)
+	{
+		FLaneGraphLane& LaneDesc = OutLanes.AddDefaulted_GetRef();
+		if (!Lane)
+			continue;
+
+		LaneDesc.bSpline = Lane->bSpline;
+
+		const TArray<FWaypoint>& Waypoints = Lane->GetWaypoints();
+		for (int32 WaypointIndex = 0; WaypointIndex < Waypoints.Num(); ++WaypointIndex)
+		{
+			const FWaypoint& Waypoint = Waypoints[WaypointIndex];
+			FLaneGraphWaypoint& WaypointDesc = LaneDesc.Waypoints.AddDefaulted_GetRef();
+			WaypointDesc.Location = Waypoint.Location;
+			WaypointDesc.TargetSpeed = Waypoint.TargetSpeed;
+			WaypointDesc.bStop = Waypoint.Stop;
+			WaypointDesc.Tangent = Waypoint.Tangent;
+
+			for (const FConnection& Connection : Waypoint.OutConnections)
+			{
+				const ALane* ToLane = Connection.Lane.Get();
+				const int32* ToLaneIndex = ToLane ? LaneIndices.Find(ToLane) : nullptr;
+				if (!ToLaneIndex || !ToLane->HasWaypointId(Connection.Id))
+					continue;
+
+				WaypointDesc.OutConnections.Add(FIntPoint(*ToLaneIndex, ToLane->GetWaypointIndex(Connection.Id)));
+				WaypointDesc.OutPriorities.Add(Connection.Priority);
+			}
+
+			// Without connections cars continue on their lane
+			if (Waypoint.OutConnections.Num() == 0 && WaypointIndex + 1 < Waypoints.Num())
+				WaypointDesc.OutConnections.Add(FIntPoint(OutLanes.Num() - 1, WaypointIndex + 1));
+		}
+	}
+}
+
+void FLaneGraph::Build(const TArrayView<const FLaneGraphLane> Lanes, FLaneGraph& OutGraph)
+{
+	OutGraph.Reset();
+
+	// Assign a contiguous node range to every lane
+	int32 NumNodes = 0;
+	for (const FLaneGraphLane& Lane : Lanes)
+	{
+		OutGraph.LaneFirstNodes.Add(NumNodes);
+		OutGraph.LaneNumNodes.Add(Lane.Waypoints.Num());
+		NumNodes += Lane.Waypoints.Num();
+	}
+
+	OutGraph.Positions.Reserve(NumNodes);
+	OutGraph.TargetSpeeds.Reserve(NumNodes);
+	OutGraph.StopFlags.Reserve(NumNodes);
+	OutGraph.NodeLanes.Reserve(NumNodes);
+	OutGraph.NodeDistances.Reserve(NumNodes);
+	OutGraph.NodeShapePoints.Reserve(NumNodes);
+	OutGraph.OutOffsets.Reserve(NumNodes + 1);
+
+	TArray<FVector> WaypointLocations;
+	TArray<FVector> WaypointTangents;
+	TArray<FVector> Points;
+	TArray<int32> WaypointPoints;
+	for (int32 LaneIndex = 0; LaneIndex < Lanes.Num(); ++LaneIndex)
+	{
+		const TArray<FLaneGraphWaypoint>& Waypoints = Lanes[LaneIndex].Waypoints;
+		WaypointLocations.Reset(Waypoints.Num());
+		WaypointTangents.Reset(Waypoints.Num());
+		for (const FLaneGraphWaypoint& Waypoint : Waypoints)
+		{
+			WaypointLocations.Add(Waypoint.Location);
+			WaypointTangents.Add(Waypoint.Tangent);
+		}
+
+		// Straight lanes are their own shape
+		if (Lanes[LaneIndex].bSpline)
+		{
+			TessellateSpline(WaypointLocations, WaypointTangents, SplineTolerance, Points, WaypointPoints);
+		}
+		else
+		{
+			Points = WaypointLocations;
+			WaypointPoints.Reset(Waypoints.Num());
+			for (int32 WaypointIndex = 0; WaypointIndex < Waypoints.Num(); ++WaypointIndex)
+			{
+				WaypointPoints.Add(WaypointIndex);
+			}
+		}
+
+		const int32 FirstPoint = OutGraph.ShapePositions.Num();
+		OutGraph.LaneFirstShapePoints.Add(FirstPoint);
+		float LaneDistance = 0.0f;
+		for (const FVector& Point : Points)
+		{
+			if (OutGraph.ShapePositions.Num() > FirstPoint)
+				LaneDistance += FVector::Dist2D(OutGraph.ShapePositions.Last(), Point);
+
+			OutGraph.ShapePositions.Add(Point);
+			OutGraph.ShapeDistances.Add(LaneDistance);
+		}
+
+		for (int32 WaypointIndex = 0; WaypointIndex < Waypoints.Num(); ++WaypointIndex)
+		{
+			const FLaneGraphWaypoint& Waypoint = Waypoints[WaypointIndex];
+			const int32 Point = FirstPoint + WaypointPoints[WaypointIndex];
+			OutGraph.Positions.Add(Waypoint.Location);
+			OutGraph.TargetSpeeds.Add(Waypoint.TargetSpeed);
+			OutGraph.MaxTargetSpeed = FMath::Max(OutGraph.MaxTargetSpeed, Waypoint.TargetSpeed);
+			OutGraph.StopFlags.Add(Waypoint.bStop ? 1 : 0);
+			OutGraph.NodeLanes.Add(LaneIndex);
+			OutGraph.NodeDistances.Add(OutGraph.ShapeDistances[Point]);
+			OutGraph.NodeShapePoints.Add(Point);
+		}
+	}
+	OutGraph.LaneFirstShapePoints.Add(OutGraph.ShapePositions.Num());
+
+	// Out edges
+	for (int32 LaneIndex = 0; LaneIndex < Lanes.Num(); ++LaneIndex)
+	{
+		const TArray<FLaneGraphWaypoint>& Waypoints = Lanes[LaneIndex].Waypoints;
+		for (int32 WaypointIndex = 0; WaypointIndex < Waypoints.Num(); ++WaypointIndex)
+		{
+			const int32 Node = OutGraph.LaneFirstNodes[LaneIndex] + WaypointIndex;
+			OutGraph.OutOffsets.Add(OutGraph.OutTargets.Num());
+
+			const FLaneGraphWaypoint& Waypoint = Waypoints[WaypointIndex];
+			for (int32 ConnectionIndex = 0; ConnectionIndex < Waypoint.OutConnections.Num(); ++ConnectionIndex)
+			{
+				const FIntPoint& Connection = Waypoint.OutConnections[ConnectionIndex];
+				if (!Lanes.IsValidIndex(Connection.X) || !Lanes[Connection.X].Waypoints.IsValidIndex(Connection.Y))
+					continue;
+
+				// The next waypoint of a spline lane is reached along the curve
+				const int32 ToNode = OutGraph.GetNodeIndex(Connection.X, Connection.Y);
+				const bool bAlongSpline = Lanes[LaneIndex].bSpline && ToNode == Node + 1 && Connection.X == LaneIndex;
+				OutGraph.OutTargets.Add(ToNode);
+				OutGraph.OutSources.Add(Node);
+				OutGraph.OutPriorities.Add(Waypoint.OutPriorities.IsValidIndex(ConnectionIndex)
+					? Waypoint.OutPriorities[ConnectionIndex]
+					: EConnectionPriority::Normal);
+				OutGraph.OutLengths.Add(bAlongSpline
+					? CalculateShapeLength(OutGraph, OutGraph.NodeShapePoints[Node], OutGraph.NodeShapePoints[ToNode])
+					: FVector::Dist(OutGraph.Positions[Node], OutGraph.Positions[ToNode]));
+			}
+		}
+	}
+	OutGraph.OutOffsets.Add(OutGraph.OutTargets.Num());
+
+	OutGraph.MaxTargetSpeed = FMath::Max(OutGraph.MaxTargetSpeed, MinCostSpeed);
+	OutGraph.OutCosts.SetNumUninitialized(OutGraph.OutTargets.Num());
+	for (int32 Edge = 0; Edge < OutGraph.OutTargets.Num(); ++Edge)
+	{
+		const float Speed = FMath::Max(OutGraph.TargetSpeeds[OutGraph.OutTargets[Edge]], MinCostSpeed);
+		OutGraph.OutCosts[Edge] = OutGraph.OutLengths[Edge] / Speed;
+	}
+
+	BakeLaneGeometry(OutGraph);
+	FindEdgeConflicts(OutGraph);
+
+	// In edges are the transposed out edges
+	TArray<int32> InCounts;
+	InCounts.SetNumZeroed(NumNodes + 1);
+	for (const int32 ToNode : OutGraph.OutTargets)
+	{
+		++InCounts[ToNode + 1];
+	}
+
+	OutGraph.InOffsets.SetNumUninitialized(NumNodes + 1);
+	OutGraph.InOffsets[0] = 0;
+	for (int32 Node = 0; Node < NumNodes; ++Node)
+	{
+		OutGraph.InOffsets[Node + 1] = OutGraph.InOffsets[Node] + InCounts[Node + 1];
+	}
+
+	TArray<int32> InCursors(OutGraph.InOffsets.GetData(), NumNodes);
+	OutGraph.InSources.SetNumUninitialized(OutGraph.OutTargets.Num());
+	OutGraph.InCosts.SetNumUninitialized(OutGraph.OutTargets.Num());
+	for (int32 Node = 0; Node < NumNodes; ++Node)
+	{
+		for (int32 Edge = OutGraph.OutOffsets[Node]; Edge < OutGraph.OutOffsets[Node + 1]; ++Edge)
+		{
+			const int32 InEdge = InCursors[OutGraph.OutTargets[Edge]]++;
+			OutGraph.InSources[InEdge] = Node;
+			OutGraph.InCosts[InEdge] = OutGraph.OutCosts[Edge];
+		}
+	}
+}
+
+void FLaneGraph::TessellateSpline(const TArrayView<const FVector> Locations,
+								  const TArrayView<const FVector> SplineTangents,
+								  const float Tolerance, TArray<FVector>& OutPoints, TArray<int32>& OutWaypointPoints)
+{
+	OutPoints.Reset();
+	OutWaypointPoints.Reset(Locations.Num());
+	for (int32 Index = 0; Index < Locations.Num(); ++Index)
+	{
+		if (Index > 0)
+		{
+			const FHermiteSegment Segment = {
+				Locations[Index - 1], CalculateSplineTangent(Locations, SplineTangents, Index - 1),
+				Locations[Index], CalculateSplineTangent(Locations, SplineTangents, Index) };
+			TessellateSegment(Segment, 0.0f, 1.0f, Segment.Start, Segment.End, Tolerance, 0, OutPoints);
+		}
+
+		OutWaypointPoints.Add(OutPoints.Add(Locations[Index]));
+	}
+}
+
+FVector FLaneGraph::CalculateSplineTangent(const TArrayView<const FVector> Locations,
+										   const TArrayView<const FVector> SplineTangents, const int32 Index)
+{
+	check(Locations.IsValidIndex(Index));
+
+	if (SplineTangents.IsValidIndex(Index) && !SplineTangents[Index].IsZero())
+		return SplineTangents[Index];
+
+	// Ends of the lane point at their neighbour
+	const int32 Previous = FMath::Max(Index - 1, 0);
+	const int32 Next = FMath::Min(Index + 1, Locations.Num() - 1);
+	return (Locations[Next] - Locations[Previous]) * (Next - Previous > 1 ? 0.5f : 1.0f);
+}
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConnectionPriority.h"
+
+class ALane;
+class UWorld;
+
+/**
+ * A location on the lane graph, given as a point on the segment between two connected nodes.
+ */
+struct TRAFFICSYSTEM_API FLaneGraphLocation
+{
+	int32 FromNode = INDEX_NONE;
+	int32 ToNode = INDEX_NONE;
+
+	// Position between FromNode (0) and ToNode (1), along the shape on spline lanes
+	float Alpha = 0.0f;
+
+	FVector Location = FVector::ZeroVector;
+	float DistanceSquared = MAX_FLT;
+
+	bool IsValid() const
+	{
+		return FromNode != INDEX_NONE;
+	}
+};
+
+// Waypoint of a lane described without actors, used to build lane graphs outside of a world
+struct TRAFFICSYSTEM_API FLaneGraphWaypoint
+{
+	FVector Location = FVector::ZeroVector;
+
+	// km/h like FWaypoint::TargetSpeed
+	float TargetSpeed = 50.0f;
+	bool bStop = false;
+
+	// Spline tangent like FWaypoint::Tangent, zero for an automatic tangent
+	FVector Tangent = FVector::ZeroVector;
+
+	// Lane (X) and waypoint index (Y) of every waypoint reachable from this one, including the next waypoint on
+	// the same lane
+	TArray<FIntPoint> OutConnections;
+
+	// Right of way of the out connections in the same order, missing entries are EConnectionPriority::Normal
+	TArray<EConnectionPriority> OutPriorities;
+};
+
+struct TRAFFICSYSTEM_API FLaneGraphLane
+{
+	TArray<FLaneGraphWaypoint> Waypoints;
+
+	// Interpolates the waypoints with a cubic Hermite spline instead of straight segments
+	bool bSpline = false;
+};
+
+/**
+ * Flat, read-only driving graph baked from ALane actors. Every waypoint becomes a node with a dense global
+ * index; the waypoints of a lane occupy a contiguous node range. Adjacency is stored in CSR form: the out
+ * edges of node N are OutTargets[OutOffsets[N] .. OutOffsets[N + 1]).
+ *
+ * Out edges follow the driving rules of the lanes: the OutConnections of a waypoint if it has any,
+ * otherwise the next waypoint on the same lane. A node without out edges is a sink.
+ */
+struct TRAFFICSYSTEM_API FLaneGraph
+{
+	// Per node
+	TArray<FVector> Positions;
+	TArray<float> TargetSpeeds;
+	TArray<uint8> StopFlags;
+	TArray<int32> NodeLanes;
+
+	// 2D distance from the first waypoint of the lane along its shape
+	TArray<float> NodeDistances;
+
+	// Shape of the lanes, the polyline vehicles follow: the nodes of straight lanes and the tessellated spline of
+	// spline lanes. The shape points of a lane are at LaneFirstShapePoints[Lane] to [Lane + 1] with their 2D
+	// distance along the lane, the arc length table of the lane, and their unit 2D tangent. Every node is a shape
+	// point, NodeShapePoints holds its index.
+	TArray<FVector> ShapePositions;
+	TArray<float> ShapeDistances;
+	TArray<FVector> ShapeTangents;
+	TArray<int32> LaneFirstShapePoints;
+	TArray<int32> NodeShapePoints;
+
+	// Lane geometry baked per node: unit 2D tangent and signed curvature in 1/cm, positive turning right. The
+	// speed limit in cm/s is the lower of the target speed and the speed through the curve, lowered ahead of
+	// slower nodes so vehicles reach it braking comfortably.
+	TArray<FVector> Tangents;
+	TArray<float> Curvatures;
+	TArray<float> SpeedLimits;
+
+	// Out edges with their 3D length, along the shape on spline lanes, and travel cost (length / target speed of
+	// the target node), in the order of FWaypoint::OutConnections
+	TArray<int32> OutOffsets;
+	TArray<int32> OutTargets;
+	TArray<float> OutLengths;
+	TArray<float> OutCosts;
+
+	// Speed in cm/s through the turn from the tangent of the source to the tangent of the target of every out edge
+	TArray<float> OutSpeedLimits;
+
+	// Source node and right of way of every out edge
+	TArray<int32> OutSources;
+	TArray<EConnectionPriority> OutPriorities;
+
+	// Conflicts of every out edge: the edges crossing it and the ones merging into the same node, found from the
+	// shapes of the edges. The conflicts of edge E are at ConflictOffsets[E] to [E + 1], with the 2D distance of
+	// the crossing point along the shape of E and of the other edge.
+	TArray<int32> ConflictOffsets;
+	TArray<int32> ConflictEdges;
+	TArray<float> ConflictDistances;
+	TArray<float> ConflictOtherDistances;
+
+	// In edges with the travel cost of the matching out edge
+	TArray<int32> InOffsets;
+	TArray<int32> InSources;
+	TArray<float> InCosts;
+
+	// Per lane
+	TArray<int32> LaneFirstNodes;
+	TArray<int32> LaneNumNodes;
+
+	// Highest target speed of all nodes, turns distances into lower bounds of the travel cost
+	float MaxTargetSpeed = 0.0f;
+
+	int32 GetNumNodes() const;
+	int32 GetNumLanes() const;
+	bool IsValidNode(int32 Node) const;
+
+	int32 GetNodeIndex(int32 LaneIndex, int32 WaypointIndex) const;
+	int32 GetWaypointIndex(int32 Node) const;
+
+	int32 GetNumOutEdges(int32 Node) const;
+	int32 GetOutEdge(int32 Node, int32 EdgeIndex) const;
+	TArrayView<const int32> GetOutEdges(int32 Node) const;
+	TArrayView<const int32> GetInEdges(int32 Node) const;
+
+	// Index of the out edge from FromNode to ToNode into OutTargets, INDEX_NONE without one
+	int32 FindEdge(int32 FromNode, int32 ToNode) const;
+	int32 GetNumConflicts(int32 Edge) const;
+
+	// Node before Distance along the lane by binary search in NodeDistances and the fraction of the way to the next
+	// node, clamped to the first and last node
+	void FindLaneSegment(int32 LaneIndex, float Distance, int32& OutNode, float& OutAlpha) const;
+
+	// Lane geometry at Distance along the lane, points interpolated between the shape points, speed limits between
+	// the nodes
+	FVector CalculateLanePoint(int32 LaneIndex, float Distance) const;
+	float CalculateSpeedLimit(int32 LaneIndex, float Distance) const;
+
+	// Shape point a vehicle at Location coming from FromNode heads for on its way to Node: the first one of the
+	// segment before Node it has not passed yet, the one of Node itself on straight segments, connections from
+	// other lanes and without FromNode
+	int32 FindNextShapePoint(int32 FromNode, int32 Node, const FVector& Location) const;
+
+	// Lower bound of the travel cost between two nodes
+	float EstimateCost(int32 FromNode, int32 ToNode) const;
+
+	// Hash of the graph topology and edge costs, identifies data precomputed for this graph
+	uint32 CalculateChecksum() const;
+
+	void Reset();
+
+	// Collects the lanes of a world in a stable order so repeated builds produce the same node indices
+	static void GatherLanes(UWorld* World, TArray<ALane*>& OutLanes);
+
+	// Bakes the graph from the given lanes. The lane index of each lane is its position in the array.
+	static void Build(const TArray<ALane*>& Lanes, FLaneGraph& OutGraph);
+	static void Build(TArrayView<const FLaneGraphLane> Lanes, FLaneGraph& OutGraph);
+
+	// Describes lane actors without references to them, applying the driving rules of ALane
+	static void DescribeLanes(const TArray<ALane*>& Lanes, TArray<FLaneGraphLane>& OutLanes);
+
+	// Samples the cubic Hermite spline through Locations, splitting every segment until it deviates less than
+	// Tolerance from the curve, so straight parts stay single segments. OutWaypointPoints holds the index of the
+	// point of every waypoint.
+	static void TessellateSpline(TArrayView<const FVector> Locations, TArrayView<const FVector> SplineTangents,
+								 float Tolerance, TArray<FVector>& OutPoints, TArray<int32>& OutWaypointPoints);
+
+	// Tangent of a spline waypoint, the Catmull-Rom tangent for waypoints without one
+	static FVector CalculateSplineTangent(TArrayView<const FVector> Locations, TArrayView<const FVector> SplineTangents,
+										  int32 Index);
+};
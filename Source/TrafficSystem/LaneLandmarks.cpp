@@ -0,0 +1,178 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaneLandmarks.h"
+
+#include "LaneGraph.h"
+
+namespace
+{
+	struct FSearchNode
+	{
+		float Cost;
+		int32 Node;
+
+		bool operator<(const FSearchNode& Other) const
+		{
+			return Cost < Other.Cost;
+		}
+	};
+
+	// Costs from Source to all nodes over the given CSR adjacency, MAX_FLT for unreachable nodes
+	void FindAllCosts(const int32 Source, const TArray<int32>& Offsets, const TArray<int32>& Targets,
+					  const TArray<float>& EdgeCosts, TArray<FSearchNode>& Heap, TArray<float>& OutCosts)
+	{
+		const int32 NumNodes = Offsets.Num() - 1;
+		OutCosts.SetNumUninitialized(NumNodes);
+		for (float& Cost : OutCosts)
+		{
+			Cost = MAX_FLT;
+		}
+
+		Heap.Reset();
+		OutCosts[Source] = 0.0f;
+		Heap.HeapPush({ 0.0f, Source });
+
+		while (Heap.Num() > 0)
+		{
+			FSearchNode Current;
+			Heap.HeapPop(Current, false);
+			if (Current.Cost > OutCosts[Current.Node])
+				continue;
+
+			for (int32 Edge = Offsets[Current.Node]; Edge < Offsets[Current.Node + 1]; ++Edge)
+			{
+				const int32 Next = Targets[Edge];
+				const float NextCost = Current.Cost + EdgeCosts[Edge];
+				if (NextCost >= OutCosts[Next])
+					continue;
+
+				OutCosts[Next] = NextCost;
+				Heap.HeapPush({ NextCost, Next });
+			}
+		}
+	}
+}
+
+int32 FLaneLandmarks::GetNumLandmarks() const
+{
+	return LandmarkNodes.Num();
+}
+
+bool FLaneLandmarks::IsValid() const
+{
+	const int32 NumEntries = NumNodes * GetNumLandmarks();
+	return NumEntries > 0 && FromLandmarkCosts.Num() == NumEntries && ToLandmarkCosts.Num() == NumEntries;
+}
+
+bool FLaneLandmarks::IsCompatible(const FLaneGraph& Graph) const
+{
+	return IsValid() && NumNodes == Graph.GetNumNodes() && GraphChecksum == Graph.CalculateChecksum();
+}
+
+float FLaneLandmarks::EstimateCost(const int32 FromNode, const int32 ToNode) const
+{
+	const int32 NumLandmarks = GetNumLandmarks();
+	const float* FromCosts = FromLandmarkCosts.GetData();
+	const float* ToCosts = ToLandmarkCosts.GetData();
+	const int32 FromOffset = FromNode * NumLandmarks;
+	const int32 ToOffset = ToNode * NumLandmarks;
+
+	// cost(From, To) >= cost(L, To) - cost(L, From) and cost(From, To) >= cost(From, L) - cost(To, L)
+	float Estimate = 0.0f;
+	for (int32 Landmark = 0; Landmark < NumLandmarks; ++Landmark)
+	{
+		const float LandmarkToFrom = FromCosts[FromOffset + Landmark];
+		const float LandmarkToTo = FromCosts[ToOffset + Landmark];
+		if (LandmarkToFrom != MAX_FLT && LandmarkToTo != MAX_FLT)
+			Estimate = FMath::Max(Estimate, LandmarkToTo - LandmarkToFrom);
+
+		const float FromToLandmark = ToCosts[FromOffset + Landmark];
+		const float ToToLandmark = ToCosts[ToOffset + Landmark];
+		if (FromToLandmark != MAX_FLT && ToToLandmark != MAX_FLT)
+			Estimate = FMath::Max(Estimate, FromToLandmark - ToToLandmark);
+	}
+
+	return Estimate;
+}
+
+SIZE_T FLaneLandmarks::GetAllocatedSize() const
+{
+	return LandmarkNodes.GetAllocatedSize() + FromLandmarkCosts.GetAllocatedSize() +
+		ToLandmarkCosts.GetAllocatedSize();
+}
+
+void FLaneLandmarks::Reset()
+{
+	LandmarkNodes.Reset();
+	FromLandmarkCosts.Reset();
+	ToLandmarkCosts.Reset();
+	NumNodes = 0;
+	GraphChecksum = 0;
+}
+
+void FLaneLandmarks::Build(const FLaneGraph& Graph, const int32 NumLandmarks, FLaneLandmarks& OutLandmarks)
+{
+	OutLandmarks.Reset();
+	if (Graph.GetNumNodes() == 0 || NumLandmarks <= 0)
+		return;
+
+	const int32 NumNodes = Graph.GetNumNodes();
+	TArray<FSearchNode> Heap;
+	TArray<float> FromCosts;
+	TArray<float> ToCosts;
+
+	// Distance of every node to the closest landmark, the next landmark is the node farthest away from all
+	// previous ones. Nodes that can not be reached have the highest distance which spreads the landmarks over
+	// disconnected parts of the network first.
+	TArray<float> LandmarkDistances;
+	FindAllCosts(0, Graph.OutOffsets, Graph.OutTargets, Graph.OutCosts, Heap, LandmarkDistances);
+
+	TArray<TArray<float>> LandmarkFromCosts;
+	TArray<TArray<float>> LandmarkToCosts;
+	while (OutLandmarks.LandmarkNodes.Num() < NumLandmarks)
+	{
+		int32 Landmark = INDEX_NONE;
+		float LandmarkDistance = 0.0f;
+		for (int32 Node = 0; Node < NumNodes; ++Node)
+		{
+			if (LandmarkDistances[Node] > LandmarkDistance)
+			{
+				Landmark = Node;
+				LandmarkDistance = LandmarkDistances[Node];
+			}
+		}
+
+		// Every node is a landmark already
+		if (Landmark == INDEX_NONE)
+			break;
+
+		FindAllCosts(Landmark, Graph.OutOffsets, Graph.OutTargets, Graph.OutCosts, Heap, FromCosts);
+		FindAllCosts(Landmark, Graph.InOffsets, Graph.InSources, Graph.InCosts, Heap, ToCosts);
+
+		for (int32 Node = 0; Node < NumNodes; ++Node)
+		{
+			LandmarkDistances[Node] = FMath::Min(LandmarkDistances[Node], FMath::Min(FromCosts[Node], ToCosts[Node]));
+		}
+		LandmarkDistances[Landmark] = 0.0f;
+
+		OutLandmarks.LandmarkNodes.Add(Landmark);
+		LandmarkFromCosts.Add(FromCosts);
+		LandmarkToCosts.Add(ToCosts);
+	}
+
+	const int32 NumBuiltLandmarks = OutLandmarks.LandmarkNodes.Num();
+	OutLandmarks.FromLandmarkCosts.SetNumUninitialized(NumNodes * NumBuiltLandmarks);
+	OutLandmarks.ToLandmarkCosts.SetNumUninitialized(NumNodes * NumBuiltLandmarks);
+	for (int32 Node = 0; Node < NumNodes; ++Node)
+	{
+		for (int32 Landmark = 0; Landmark < NumBuiltLandmarks; ++Landmark)
+		{
+			OutLandmarks.FromLandmarkCosts[Node * NumBuiltLandmarks + Landmark] = LandmarkFromCosts[Landmark][Node];
+			OutLandmarks.ToLandmarkCosts[Node * NumBuiltLandmarks + Landmark] = LandmarkToCosts[Landmark][Node];
+		}
+	}
+
+	OutLandmarks.NumNodes = NumNodes;
+	OutLandmarks.GraphChecksum = Graph.CalculateChecksum();
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "LaneLandmarks.generated.h"
+
+struct FLaneGraph;
+
+/**
+ * ALT (A*, landmarks, triangle inequality) tables for a FLaneGraph. For a few landmark nodes the travel cost
+ * from the landmark to every node and from every node to the landmark is precomputed; the triangle inequality
+ * turns them into a much tighter lower bound of the travel cost than the straight line distance.
+ *
+ * Costs are stored node-major so the heuristic reads the entries of one node from a single cache line.
+ */
+USTRUCT()
+struct TRAFFICSYSTEM_API FLaneLandmarks
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<int32> LandmarkNodes;
+
+	// Cost from landmark L to node N at [N * NumLandmarks + L], MAX_FLT if N can not be reached
+	UPROPERTY()
+	TArray<float> FromLandmarkCosts;
+
+	// Cost from node N to landmark L at [N * NumLandmarks + L], MAX_FLT if L can not be reached
+	UPROPERTY()
+	TArray<float> ToLandmarkCosts;
+
+	UPROPERTY()
+	int32 NumNodes = 0;
+
+	// FLaneGraph::CalculateChecksum of the graph the tables were built for
+	UPROPERTY()
+	uint32 GraphChecksum = 0;
+
+	int32 GetNumLandmarks() const;
+	bool IsValid() const;
+
+	// Tables are only usable with the exact graph they were built for
+	bool IsCompatible(const FLaneGraph& Graph) const;
+
+	// Lower bound of the travel cost between two nodes
+	float EstimateCost(int32 FromNode, int32 ToNode) const;
+
+	SIZE_T GetAllocatedSize() const;
+	void Reset();
+
+	// Picks landmarks by farthest selection and computes their cost tables with two Dijkstra searches each
+	static void Build(const FLaneGraph& Graph, int32 NumLandmarks, FLaneLandmarks& OutLandmarks);
+};
@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaneOccupancy.h"
+
+#include "Algo/BinarySearch.h"
+#include "TrafficSerialization.h"
+
+void FLaneOccupancy::Reset(const int32 NumLanes)
+{
+	LaneOccupants.Reset();
+	LaneOccupants.SetNum(NumLanes);
+	DirtyLanes.Reset();
+	DirtyLanes.SetNumZeroed(NumLanes);
+	DirtyLaneList.Reset();
+	HandleLanes.Reset();
+	HandleSlots.Reset();
+}
+
+void FLaneOccupancy::Update(const int32 Handle, const int32 Lane, const float Distance)
+{
+	check(Handle >= 0);
+
+	if (!HandleLanes.IsValidIndex(Handle))
+	{
+		const int32 NumAdded = Handle + 1 - HandleLanes.Num();
+		HandleLanes.Reserve(Handle + 1);
+		HandleSlots.Reserve(Handle + 1);
+		for (int32 Count = 0; Count < NumAdded; ++Count)
+		{
+			HandleLanes.Add(INDEX_NONE);
+			HandleSlots.Add(INDEX_NONE);
+		}
+	}
+
+	const int32 CurrentLane = HandleLanes[Handle];
+	if (CurrentLane == Lane && Lane != INDEX_NONE)
+	{
+		LaneOccupants[Lane][HandleSlots[Handle]].Distance = Distance;
+		if (!DirtyLanes[Lane])
+		{
+			DirtyLanes[Lane] = 1;
+			DirtyLaneList.Add(Lane);
+		}
+		return;
+	}
+
+	Remove(Handle);
+	if (LaneOccupants.IsValidIndex(Lane))
+		Insert(Handle, Lane, Distance);
+}
+
+void FLaneOccupancy::Remove(const int32 Handle)
+{
+	if (!HandleLanes.IsValidIndex(Handle) || HandleLanes[Handle] == INDEX_NONE)
+		return;
+
+	const int32 Lane = HandleLanes[Handle];
+	const int32 Slot = HandleSlots[Handle];
+	LaneOccupants[Lane].RemoveAt(Slot, 1, false);
+	UpdateSlots(Lane, Slot);
+
+	HandleLanes[Handle] = INDEX_NONE;
+	HandleSlots[Handle] = INDEX_NONE;
+}
+
+void FLaneOccupancy::SortLanes()
+{
+	for (const int32 Lane : DirtyLaneList)
+	{
+		DirtyLanes[Lane] = 0;
+
+		TArray<FLaneOccupant>& Occupants = LaneOccupants[Lane];
+		int32 FirstMoved = Occupants.Num();
+		for (int32 Slot = 1; Slot < Occupants.Num(); ++Slot)
+		{
+			const FLaneOccupant Occupant = Occupants[Slot];
+			int32 Target = Slot;
+			while (Target > 0 && Occupants[Target - 1].Distance > Occupant.Distance)
+			{
+				Occupants[Target] = Occupants[Target - 1];
+				--Target;
+			}
+
+			if (Target != Slot)
+			{
+				Occupants[Target] = Occupant;
+				FirstMoved = FMath::Min(FirstMoved, Target);
+			}
+		}
+
+		UpdateSlots(Lane, FirstMoved);
+	}
+	DirtyLaneList.Reset();
+}
+
+int32 FLaneOccupancy::GetLane(const int32 Handle) const
+{
+	return HandleLanes.IsValidIndex(Handle) ? HandleLanes[Handle] : INDEX_NONE;
+}
+
+bool FLaneOccupancy::GetNextOnLane(const int32 Handle, FLaneOccupant& OutOccupant) const
+{
+	const int32 Lane = GetLane(Handle);
+	if (Lane == INDEX_NONE)
+		return false;
+
+	const TArray<FLaneOccupant>& Occupants = LaneOccupants[Lane];
+	const int32 NextSlot = HandleSlots[Handle] + 1;
+	if (!Occupants.IsValidIndex(NextSlot))
+		return false;
+
+	OutOccupant = Occupants[NextSlot];
+	return true;
+}
+
+bool FLaneOccupancy::FindFirstFrom(const int32 Lane, const float Distance, FLaneOccupant& OutOccupant) const
+{
+	if (!LaneOccupants.IsValidIndex(Lane))
+		return false;
+
+	const int32 Slot = LowerBound(Lane, Distance);
+	if (!LaneOccupants[Lane].IsValidIndex(Slot))
+		return false;
+
+	OutOccupant = LaneOccupants[Lane][Slot];
+	return true;
+}
+
+bool FLaneOccupancy::FindLastBefore(const int32 Lane, const float Distance, FLaneOccupant& OutOccupant) const
+{
+	if (!LaneOccupants.IsValidIndex(Lane))
+		return false;
+
+	const int32 Slot = LowerBound(Lane, Distance) - 1;
+	if (!LaneOccupants[Lane].IsValidIndex(Slot))
+		return false;
+
+	OutOccupant = LaneOccupants[Lane][Slot];
+	return true;
+}
+
+int32 FLaneOccupancy::CountInRange(const int32 Lane, const float MinDistance, const float MaxDistance) const
+{
+	if (!LaneOccupants.IsValidIndex(Lane) || MaxDistance <= MinDistance)
+		return 0;
+
+	return LowerBound(Lane, MaxDistance) - LowerBound(Lane, MinDistance);
+}
+
+TArrayView<const FLaneOccupant> FLaneOccupancy::GetOccupantsInRange(const int32 Lane, const float MinDistance,
+																   const float MaxDistance) const
+{
+	if (!LaneOccupants.IsValidIndex(Lane) || MaxDistance <= MinDistance)
+		return TArrayView<const FLaneOccupant>();
+
+	const int32 FirstSlot = LowerBound(Lane, MinDistance);
+	return TArrayView<const FLaneOccupant>(LaneOccupants[Lane].GetData() + FirstSlot,
+										   LowerBound(Lane, MaxDistance) - FirstSlot);
+}
+
+TArrayView<const FLaneOccupant> FLaneOccupancy::GetOccupants(const int32 Lane) const
+{
+	return LaneOccupants.IsValidIndex(Lane) ? MakeArrayView(LaneOccupants[Lane]) : TArrayView<const FLaneOccupant>();
+}
+
+void FLaneOccupancy::Serialize(FArchive& Ar)
+{
+	int32 NumLanes = LaneOccupants.Num();
+	Ar << NumLanes;
+	if (Ar.IsLoading())
+	{
+		if (NumLanes < 0 || NumLanes > Ar.TotalSize() - Ar.Tell())
+		{
+			Ar.SetError();
+			return;
+		}
+		LaneOccupants.SetNum(NumLanes);
+	}
+
+	for (TArray<FLaneOccupant>& Occupants : LaneOccupants)
+	{
+		TrafficSerialization::SerializeArray(Ar, Occupants);
+	}
+	TrafficSerialization::SerializeArray(Ar, DirtyLanes);
+	TrafficSerialization::SerializeArray(Ar, DirtyLaneList);
+	TrafficSerialization::SerializeArray(Ar, HandleLanes);
+	TrafficSerialization::SerializeArray(Ar, HandleSlots);
+}
+
+void FLaneOccupancy::Insert(const int32 Handle, const int32 Lane, const float Distance)
+{
+	const int32 Slot = LowerBound(Lane, Distance);
+	FLaneOccupant Occupant;
+	Occupant.Handle = Handle;
+	Occupant.Distance = Distance;
+	LaneOccupants[Lane].Insert(Occupant, Slot);
+
+	HandleLanes[Handle] = Lane;
+	UpdateSlots(Lane, Slot);
+}
+
+void FLaneOccupancy::UpdateSlots(const int32 Lane, const int32 FirstSlot)
+{
+	const TArray<FLaneOccupant>& Occupants = LaneOccupants[Lane];
+	for (int32 Slot = FirstSlot; Slot < Occupants.Num(); ++Slot)
+	{
+		HandleSlots[Occupants[Slot].Handle] = Slot;
+	}
+}
+
+int32 FLaneOccupancy::LowerBound(const int32 Lane, const float Distance) const
+{
+	return Algo::LowerBoundBy(LaneOccupants[Lane], Distance, [](const FLaneOccupant& Occupant)
+	{
+		return Occupant.Distance;
+	});
+}
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct TRAFFICSYSTEM_API FLaneOccupant
+{
+	int32 Handle = INDEX_NONE;
+
+	// Distance along the lane, negative while the vehicle is still approaching the first waypoint
+	float Distance = 0.0f;
+};
+
+/**
+ * Vehicles on every lane ordered by their distance along the lane. Vehicles are tracked by their stable
+ * handle together with their slot in the lane, so the vehicle ahead on the same lane is a direct lookup.
+ * Moving to another lane is an ordered insert; distance updates on the same lane only mark the lane and
+ * SortLanes restores the order with an insertion sort, which is linear since vehicles rarely overtake.
+ */
+class TRAFFICSYSTEM_API FLaneOccupancy
+{
+public:
+	void Reset(int32 NumLanes);
+
+	// Moves the vehicle to Lane at Distance, Lane INDEX_NONE removes it
+	void Update(int32 Handle, int32 Lane, float Distance);
+	void Remove(int32 Handle);
+
+	// Restores the order of all lanes updated since the last call
+	void SortLanes();
+
+	int32 GetLane(int32 Handle) const;
+
+	// Vehicle directly ahead of Handle on its lane
+	bool GetNextOnLane(int32 Handle, FLaneOccupant& OutOccupant) const;
+
+	// First vehicle on Lane at or beyond Distance
+	bool FindFirstFrom(int32 Lane, float Distance, FLaneOccupant& OutOccupant) const;
+
+	// Last vehicle on Lane before Distance
+	bool FindLastBefore(int32 Lane, float Distance, FLaneOccupant& OutOccupant) const;
+
+	// Vehicles on Lane at or beyond MinDistance and before MaxDistance
+	int32 CountInRange(int32 Lane, float MinDistance, float MaxDistance) const;
+	TArrayView<const FLaneOccupant> GetOccupantsInRange(int32 Lane, float MinDistance, float MaxDistance) const;
+
+	TArrayView<const FLaneOccupant> GetOccupants(int32 Lane) const;
+
+	// Writes or reads the order of all lanes, which decides between vehicles at the same distance
+	void Serialize(FArchive& Ar);
+
+protected:
+	void Insert(int32 Handle, int32 Lane, float Distance);
+	void UpdateSlots(int32 Lane, int32 FirstSlot);
+	int32 LowerBound(int32 Lane, float Distance) const;
+
+	TArray<TArray<FLaneOccupant>> LaneOccupants;
+	TArray<uint8> DirtyLanes;
+	TArray<int32> DirtyLaneList;
+
+	// Per handle
+	TArray<int32> HandleLanes;
+	TArray<int32> HandleSlots;
+};
@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaneRoutePlanner.h"
+
+#include "Algo/Reverse.h"
+#include "LaneGraph.h"
+#include "LaneLandmarks.h"
+
+namespace
+{
+	float EstimateCost(const FLaneGraph& Graph, const FLaneLandmarks* Landmarks, const int32 FromNode,
+					   const int32 ToNode)
+	{
+		const float Estimate = Graph.EstimateCost(FromNode, ToNode);
+		return Landmarks ? FMath::Max(Estimate, Landmarks->EstimateCost(FromNode, ToNode)) : Estimate;
+	}
+}
+
+bool FLaneRoutePlanner::FindRoute(const FLaneGraph& Graph, const int32 StartNode, const int32 GoalNode,
+								  TArray<int32>& OutRoute, const FLaneLandmarks* Landmarks)
+{
+	OutRoute.Reset();
+	NumExpandedNodes = 0;
+	if (!Graph.IsValidNode(StartNode) || !Graph.IsValidNode(GoalNode))
+		return false;
+
+	if (Landmarks && Landmarks->NumNodes != Graph.GetNumNodes())
+		Landmarks = nullptr;
+
+	PrepareQuery(Graph.GetNumNodes());
+
+	Costs[StartNode] = 0.0f;
+	Parents[StartNode] = INDEX_NONE;
+	VisitedStamps[StartNode] = QueryStamp;
+	OpenHeap.HeapPush({ EstimateCost(Graph, Landmarks, StartNode, GoalNode), StartNode });
+
+	bool bFoundGoal = false;
+	while (OpenHeap.Num() > 0)
+	{
+		FOpenNode Current;
+		OpenHeap.HeapPop(Current, false);
+
+		// Nodes are pushed again when a cheaper path is found, skip the outdated entries
+		if (IsClosed(Current.Node))
+			continue;
+
+		ClosedStamps[Current.Node] = QueryStamp;
+		++NumExpandedNodes;
+
+		if (Current.Node == GoalNode)
+		{
+			bFoundGoal = true;
+			break;
+		}
+
+		const float CurrentCost = Costs[Current.Node];
+		for (int32 Edge = Graph.OutOffsets[Current.Node]; Edge < Graph.OutOffsets[Current.Node + 1]; ++Edge)
+		{
+			const int32 Next = Graph.OutTargets[Edge];
+			if (IsClosed(Next))
+				continue;
+
+			const float NextCost = CurrentCost + Graph.OutCosts[Edge];
+			if (IsVisited(Next) && Costs[Next] <= NextCost)
+				continue;
+
+			Costs[Next] = NextCost;
+			Parents[Next] = Current.Node;
+			VisitedStamps[Next] = QueryStamp;
+			OpenHeap.HeapPush({ NextCost + EstimateCost(Graph, Landmarks, Next, GoalNode), Next });
+		}
+	}
+
+	if (!bFoundGoal)
+		return false;
+
+	for (int32 Node = GoalNode; Node != INDEX_NONE; Node = Parents[Node])
+	{
+		OutRoute.Add(Node);
+	}
+	Algo::Reverse(OutRoute);
+
+	return true;
+}
+
+int32 FLaneRoutePlanner::GetNumExpandedNodes() const
+{
+	return NumExpandedNodes;
+}
+
+void FLaneRoutePlanner::PrepareQuery(const int32 NumNodes)
+{
+	if (Costs.Num() != NumNodes)
+	{
+		Costs.SetNumUninitialized(NumNodes);
+		Parents.SetNumUninitialized(NumNodes);
+		VisitedStamps.Reset();
+		VisitedStamps.SetNumZeroed(NumNodes);
+		ClosedStamps.Reset();
+		ClosedStamps.SetNumZeroed(NumNodes);
+		QueryStamp = 0;
+	}
+
+	// Start over once the stamp wraps around so no stale entry matches the new stamp
+	++QueryStamp;
+	if (QueryStamp == 0)
+	{
+		FMemory::Memzero(VisitedStamps.GetData(), VisitedStamps.Num() * sizeof(uint32));
+		FMemory::Memzero(ClosedStamps.GetData(), ClosedStamps.Num() * sizeof(uint32));
+		QueryStamp = 1;
+	}
+
+	OpenHeap.Reset();
+}
+
+bool FLaneRoutePlanner::IsVisited(const int32 Node) const
+{
+	return VisitedStamps[Node] == QueryStamp;
+}
+
+bool FLaneRoutePlanner::IsClosed(const int32 Node) const
+{
+	return ClosedStamps[Node] == QueryStamp;
+}
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FLaneGraph;
+struct FLaneLandmarks;
+
+/**
+ * A* search over a FLaneGraph using the travel cost of its edges. All search state is kept in buffers
+ * sized to the graph and reused between queries; a query stamp marks which entries are valid so the
+ * buffers never have to be cleared. A planner is not thread safe, use one instance per thread.
+ *
+ * With landmark tables the heuristic is the larger of the straight line and the landmark estimate, both are
+ * lower bounds so routes stay optimal while far fewer nodes are expanded.
+ */
+class TRAFFICSYSTEM_API FLaneRoutePlanner
+{
+public:
+	// Finds the cheapest route and writes its nodes, including start and goal, to OutRoute
+	bool FindRoute(const FLaneGraph& Graph, int32 StartNode, int32 GoalNode, TArray<int32>& OutRoute,
+				   const FLaneLandmarks* Landmarks = nullptr);
+
+	// Number of nodes expanded by the last query
+	int32 GetNumExpandedNodes() const;
+
+protected:
+	struct FOpenNode
+	{
+		float EstimatedCost;
+		int32 Node;
+
+		bool operator<(const FOpenNode& Other) const
+		{
+			return EstimatedCost < Other.EstimatedCost;
+		}
+	};
+
+	void PrepareQuery(int32 NumNodes);
+	bool IsVisited(int32 Node) const;
+	bool IsClosed(int32 Node) const;
+
+	TArray<FOpenNode> OpenHeap;
+	TArray<float> Costs;
+	TArray<int32> Parents;
+	TArray<uint32> VisitedStamps;
+	TArray<uint32> ClosedStamps;
+
+	uint32 QueryStamp = 0;
+	int32 NumExpandedNodes = 0;
+};
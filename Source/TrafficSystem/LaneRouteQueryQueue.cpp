@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaneRouteQueryQueue.h"
+
+#include "LaneGraph.h"
+#include "LaneLandmarks.h"
+#include "LaneRoutePlanner.h"
+
+FLaneRouteQueryQueue::FLaneRouteQueryQueue() = default;
+
+FLaneRouteQueryQueue::~FLaneRouteQueryQueue()
+{
+	Flush();
+}
+
+void FLaneRouteQueryQueue::SetGraph(TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> InGraph,
+									TSharedPtr<const FLaneLandmarks, ESPMode::ThreadSafe> InLandmarks)
+{
+	Reset();
+	Graph = MoveTemp(InGraph);
+	Landmarks = MoveTemp(InLandmarks);
+}
+
+int32 FLaneRouteQueryQueue::Submit(const int32 StartNode, const int32 GoalNode)
+{
+	FLaneRouteQuery& Query = PendingQueries.AddDefaulted_GetRef();
+	Query.Ticket = NextTicket;
+	Query.StartNode = StartNode;
+	Query.GoalNode = GoalNode;
+	Query.SubmitTime = FPlatformTime::Seconds();
+
+	NextTicket = NextTicket == MAX_int32 ? 0 : NextTicket + 1;
+	return Query.Ticket;
+}
+
+void FLaneRouteQueryQueue::Update(TArray<FLaneRouteQueryResult>& OutResults)
+{
+	CollectFinishedBatches(OutResults);
+	DispatchBatches();
+
+	Stats.NumPending = PendingQueries.Num() - PendingHead;
+	Stats.NumInFlight = 0;
+	for (const TUniquePtr<FBatch>& Batch : InFlightBatches)
+	{
+		Stats.NumInFlight += Batch->Queries.Num();
+	}
+}
+
+void FLaneRouteQueryQueue::Flush()
+{
+	for (const TUniquePtr<FBatch>& Batch : InFlightBatches)
+	{
+		if (Batch->CompletionEvent.IsValid())
+			FTaskGraphInterface::Get().WaitUntilTaskCompletes(Batch->CompletionEvent);
+	}
+}
+
+void FLaneRouteQueryQueue::Reset()
+{
+	Flush();
+	InFlightBatches.Reset();
+	PendingQueries.Reset();
+	PendingHead = 0;
+	Stats = FLaneRouteQueryStats();
+}
+
+const FLaneRouteQueryStats& FLaneRouteQueryQueue::GetStats() const
+{
+	return Stats;
+}
+
+void FLaneRouteQueryQueue::CollectFinishedBatches(TArray<FLaneRouteQueryResult>& OutResults)
+{
+	const double Now = FPlatformTime::Seconds();
+	double TotalLatency = 0.0;
+	int64 TotalExpandedNodes = 0;
+	int32 NumCompleted = 0;
+
+	for (int32 BatchIndex = 0; BatchIndex < InFlightBatches.Num(); ++BatchIndex)
+	{
+		FBatch& Batch = *InFlightBatches[BatchIndex];
+		if (!Batch.CompletionEvent->IsComplete())
+			continue;
+
+		for (int32 QueryIndex = 0; QueryIndex < Batch.Queries.Num(); ++QueryIndex)
+		{
+			TotalLatency += Now - Batch.Queries[QueryIndex].SubmitTime;
+			TotalExpandedNodes += Batch.Results[QueryIndex].NumExpandedNodes;
+			OutResults.Add(MoveTemp(Batch.Results[QueryIndex]));
+		}
+		NumCompleted += Batch.Queries.Num();
+
+		FreePlanners.Add(MoveTemp(Batch.Planner));
+		InFlightBatches.RemoveAt(BatchIndex--, 1, false);
+	}
+
+	Stats.NumCompletedLastUpdate = NumCompleted;
+	Stats.NumCompletedTotal += NumCompleted;
+	Stats.AverageLatencySeconds = NumCompleted > 0 ? TotalLatency / NumCompleted : 0.0;
+	Stats.AverageExpandedNodes = NumCompleted > 0 ? static_cast<float>(TotalExpandedNodes) / NumCompleted : 0.0f;
+}
+
+void FLaneRouteQueryQueue::DispatchBatches()
+{
+	const int32 NumToDispatch =
+		Graph.IsValid() ? FMath::Min(PendingQueries.Num() - PendingHead, FMath::Max(MaxQueriesPerUpdate, 0)) : 0;
+	Stats.NumDispatchedLastUpdate = NumToDispatch;
+	if (NumToDispatch == 0)
+		return;
+
+	const int32 QueriesPerBatch = FMath::Max(BatchSize, 1);
+	for (int32 First = 0; First < NumToDispatch; First += QueriesPerBatch)
+	{
+		TUniquePtr<FBatch>& Batch = InFlightBatches.Add_GetRef(MakeUnique<FBatch>());
+		Batch->Queries.Append(PendingQueries.GetData() + PendingHead + First,
+							  FMath::Min(QueriesPerBatch, NumToDispatch - First));
+		Batch->Results.SetNum(Batch->Queries.Num());
+		Batch->Planner = FreePlanners.Num() > 0 ? FreePlanners.Pop(false) : MakeUnique<FLaneRoutePlanner>();
+
+		// The batch is owned by the queue which waits for the task before releasing it
+		FBatch* BatchPtr = Batch.Get();
+		TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> GraphSnapshot = Graph;
+		TSharedPtr<const FLaneLandmarks, ESPMode::ThreadSafe> LandmarksSnapshot = Landmarks;
+		Batch->CompletionEvent = FFunctionGraphTask::CreateAndDispatchWhenReady(
+			[BatchPtr, GraphSnapshot, LandmarksSnapshot]()
+		{
+			for (int32 QueryIndex = 0; QueryIndex < BatchPtr->Queries.Num(); ++QueryIndex)
+			{
+				const FLaneRouteQuery& Query = BatchPtr->Queries[QueryIndex];
+				FLaneRouteQueryResult& Result = BatchPtr->Results[QueryIndex];
+				Result.Ticket = Query.Ticket;
+				Result.bSuccess = BatchPtr->Planner->FindRoute(*GraphSnapshot, Query.StartNode, Query.GoalNode,
+															   Result.Route, LandmarksSnapshot.Get());
+				Result.NumExpandedNodes = BatchPtr->Planner->GetNumExpandedNodes();
+			}
+		}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+	}
+
+	// Drop the dispatched queries, compact once the consumed head dominates the array
+	PendingHead += NumToDispatch;
+	if (PendingHead == PendingQueries.Num())
+	{
+		PendingQueries.Reset();
+		PendingHead = 0;
+	}
+	else if (PendingHead > PendingQueries.Num() / 2)
+	{
+		PendingQueries.RemoveAt(0, PendingHead, false);
+		PendingHead = 0;
+	}
+}
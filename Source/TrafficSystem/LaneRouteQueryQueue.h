@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/TaskGraphInterfaces.h"
+
+struct FLaneGraph;
+struct FLaneLandmarks;
+class FLaneRoutePlanner;
+
+struct TRAFFICSYSTEM_API FLaneRouteQuery
+{
+	int32 Ticket = INDEX_NONE;
+	int32 StartNode = INDEX_NONE;
+	int32 GoalNode = INDEX_NONE;
+	double SubmitTime = 0.0;
+};
+
+struct TRAFFICSYSTEM_API FLaneRouteQueryResult
+{
+	int32 Ticket = INDEX_NONE;
+	bool bSuccess = false;
+	TArray<int32> Route;
+	int32 NumExpandedNodes = 0;
+};
+
+struct TRAFFICSYSTEM_API FLaneRouteQueryStats
+{
+	// Queries waiting to be dispatched
+	int32 NumPending = 0;
+
+	// Queries running on worker threads
+	int32 NumInFlight = 0;
+
+	int32 NumDispatchedLastUpdate = 0;
+	int32 NumCompletedLastUpdate = 0;
+	int64 NumCompletedTotal = 0;
+
+	// Time from submission to the result being handed back, averaged over the last update
+	double AverageLatencySeconds = 0.0;
+
+	// Nodes expanded per query, averaged over the last update
+	float AverageExpandedNodes = 0.0f;
+};
+
+/**
+ * Runs route queries on the task graph. Queries are submitted on the game thread and dispatched in batches
+ * by Update, limited to a number of queries per update. Each batch searches an immutable snapshot of the
+ * lane graph with its own planner; finished results are handed back by a later Update.
+ */
+class TRAFFICSYSTEM_API FLaneRouteQueryQueue
+{
+public:
+	FLaneRouteQueryQueue();
+	~FLaneRouteQueryQueue();
+
+	FLaneRouteQueryQueue(const FLaneRouteQueryQueue&) = delete;
+	FLaneRouteQueryQueue& operator=(const FLaneRouteQueryQueue&) = delete;
+
+	// Waits for running batches and drops all queries. Landmarks are optional and must match the graph.
+	void SetGraph(TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> InGraph,
+				  TSharedPtr<const FLaneLandmarks, ESPMode::ThreadSafe> InLandmarks = nullptr);
+
+	// Returns the ticket the result will be reported with
+	int32 Submit(int32 StartNode, int32 GoalNode);
+
+	// Collects finished batches into OutResults and dispatches the next batches
+	void Update(TArray<FLaneRouteQueryResult>& OutResults);
+
+	// Blocks until all running batches are finished
+	void Flush();
+	void Reset();
+
+	const FLaneRouteQueryStats& GetStats() const;
+
+	// Budget of queries dispatched per Update
+	int32 MaxQueriesPerUpdate = 256;
+	int32 BatchSize = 32;
+
+protected:
+	struct FBatch
+	{
+		TArray<FLaneRouteQuery> Queries;
+		TArray<FLaneRouteQueryResult> Results;
+		TUniquePtr<FLaneRoutePlanner> Planner;
+		FGraphEventRef CompletionEvent;
+	};
+
+	void CollectFinishedBatches(TArray<FLaneRouteQueryResult>& OutResults);
+	void DispatchBatches();
+
+	TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> Graph;
+	TSharedPtr<const FLaneLandmarks, ESPMode::ThreadSafe> Landmarks;
+
+	// Pending queries start at PendingHead
+	TArray<FLaneRouteQuery> PendingQueries;
+	int32 PendingHead = 0;
+
+	TArray<TUniquePtr<FBatch>> InFlightBatches;
+	TArray<TUniquePtr<FLaneRoutePlanner>> FreePlanners;
+
+	int32 NextTicket = 0;
+	FLaneRouteQueryStats Stats;
+};
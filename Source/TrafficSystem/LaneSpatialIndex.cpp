@@ -0,0 +1,403 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaneSpatialIndex.h"
+
+#include "EngineDefines.h"
+
+namespace
+{
+	// Upper bound for the number of grid cells relative to the number of segments
+	constexpr int32 MaxCellsPerSegment = 4;
+	constexpr int32 MinMaxCells = 1024;
+
+	bool IsCloser(const FLaneGraphLocation& A, const FLaneGraphLocation& B)
+	{
+		if (A.DistanceSquared != B.DistanceSquared)
+			return A.DistanceSquared < B.DistanceSquared;
+		if (A.FromNode != B.FromNode)
+			return A.FromNode < B.FromNode;
+		return A.ToNode < B.ToNode;
+	}
+}
+
+template <typename FunctorType>
+void FLaneSpatialIndex::ForEachCellInRing(const FIntPoint& Center, const int32 Ring, FunctorType&& Visitor) const
+{
+	if (Ring == 0)
+	{
+		Visitor(Center.X, Center.Y);
+		return;
+	}
+
+	const int32 MinX = Center.X - Ring;
+	const int32 MaxX = Center.X + Ring;
+	const int32 MinY = Center.Y - Ring;
+	const int32 MaxY = Center.Y + Ring;
+	for (int32 Y = FMath::Max(MinY, 0); Y <= FMath::Min(MaxY, NumCellsY - 1); ++Y)
+	{
+		if (Y == MinY || Y == MaxY)
+		{
+			for (int32 X = FMath::Max(MinX, 0); X <= FMath::Min(MaxX, NumCellsX - 1); ++X)
+			{
+				Visitor(X, Y);
+			}
+		}
+		else
+		{
+			if (MinX >= 0)
+				Visitor(MinX, Y);
+			if (MaxX < NumCellsX)
+				Visitor(MaxX, Y);
+		}
+	}
+}
+
+void FLaneSpatialIndex::Build(const FLaneGraph& Graph, const float InCellSize)
+{
+	Reset();
+
+	const int32 NumNodes = Graph.GetNumNodes();
+	for (int32 Node = 0; Node < NumNodes; ++Node)
+	{
+		for (const int32 ToNode : Graph.GetOutEdges(Node))
+		{
+			// Edges along a lane follow its shape, which has points between the nodes on spline lanes
+			const bool bAlongLane = ToNode == Node + 1 && Graph.NodeLanes[Node] == Graph.NodeLanes[ToNode];
+			const int32 FirstPoint = bAlongLane ? Graph.NodeShapePoints[Node] : INDEX_NONE;
+			const int32 LastPoint = bAlongLane ? Graph.NodeShapePoints[ToNode] : INDEX_NONE;
+			if (LastPoint - FirstPoint < 2)
+			{
+				AddSegment(Node, ToNode, Graph.Positions[Node], Graph.Positions[ToNode], 0.0f, 1.0f);
+				continue;
+			}
+
+			const float StartDistance = Graph.ShapeDistances[FirstPoint];
+			const float Length = FMath::Max(Graph.ShapeDistances[LastPoint] - StartDistance, SMALL_NUMBER);
+			for (int32 Point = FirstPoint + 1; Point <= LastPoint; ++Point)
+			{
+				AddSegment(Node, ToNode, Graph.ShapePositions[Point - 1], Graph.ShapePositions[Point],
+						   (Graph.ShapeDistances[Point - 1] - StartDistance) / Length,
+						   (Graph.ShapeDistances[Point] - StartDistance) / Length);
+			}
+		}
+
+		// Keep isolated nodes findable
+		if (Graph.GetNumOutEdges(Node) == 0 && Graph.GetInEdges(Node).Num() == 0)
+			AddSegment(Node, Node, Graph.Positions[Node], Graph.Positions[Node], 0.0f, 0.0f);
+	}
+
+	const int32 NumSegments = SegmentFromNodes.Num();
+	if (NumSegments == 0)
+		return;
+
+	FBox2D Bounds(ForceInit);
+	for (int32 Segment = 0; Segment < NumSegments; ++Segment)
+	{
+		Bounds += FVector2D(SegmentStarts[Segment]);
+		Bounds += FVector2D(SegmentEnds[Segment]);
+	}
+
+	// Grow the cells for sparse networks spread over a large area
+	Origin = Bounds.Min;
+	CellSize = FMath::Max(InCellSize, 1.0f);
+	const int64 MaxCells = FMath::Max<int64>(MinMaxCells, int64(NumSegments) * MaxCellsPerSegment);
+	do
+	{
+		NumCellsX = FMath::FloorToInt((Bounds.Max.X - Bounds.Min.X) / CellSize) + 1;
+		NumCellsY = FMath::FloorToInt((Bounds.Max.Y - Bounds.Min.Y) / CellSize) + 1;
+		if (int64(NumCellsX) * NumCellsY <= MaxCells)
+			break;
+
+		CellSize *= 2.0f;
+	}
+	while (true);
+
+	// Count the segments overlapping each cell, then fill the cells
+	const int32 NumCells = NumCellsX * NumCellsY;
+	CellOffsets.SetNumZeroed(NumCells + 1);
+	for (int32 Pass = 0; Pass < 2; ++Pass)
+	{
+		TArray<int32> CellCursors;
+		if (Pass == 1)
+		{
+			for (int32 Cell = 0; Cell < NumCells; ++Cell)
+			{
+				CellOffsets[Cell + 1] += CellOffsets[Cell];
+			}
+			CellSegments.SetNumUninitialized(CellOffsets[NumCells]);
+			CellCursors.Append(CellOffsets.GetData(), NumCells);
+		}
+
+		for (int32 Segment = 0; Segment < NumSegments; ++Segment)
+		{
+			const FIntPoint MinCell = GetCell(SegmentStarts[Segment].ComponentMin(SegmentEnds[Segment]));
+			const FIntPoint MaxCell = GetCell(SegmentStarts[Segment].ComponentMax(SegmentEnds[Segment]));
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+			{
+				for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+				{
+					const int32 Cell = GetCellIndex(X, Y);
+					if (Pass == 0)
+					{
+						++CellOffsets[Cell + 1];
+					}
+					else
+					{
+						CellSegments[CellCursors[Cell]++] = Segment;
+					}
+				}
+			}
+		}
+	}
+}
+
+void FLaneSpatialIndex::Reset()
+{
+	SegmentFromNodes.Reset();
+	SegmentToNodes.Reset();
+	SegmentStarts.Reset();
+	SegmentEnds.Reset();
+	SegmentAlphaStarts.Reset();
+	SegmentAlphaEnds.Reset();
+	CellOffsets.Reset();
+	CellSegments.Reset();
+	Origin = FVector2D::ZeroVector;
+	NumCellsX = 0;
+	NumCellsY = 0;
+}
+
+bool FLaneSpatialIndex::IsEmpty() const
+{
+	return SegmentFromNodes.Num() == 0;
+}
+
+int32 FLaneSpatialIndex::GetNumSegments() const
+{
+	return SegmentFromNodes.Num();
+}
+
+bool FLaneSpatialIndex::FindNearest(const FVector& Location, const float MaxRadius,
+									FLaneGraphLocation& OutLocation) const
+{
+	OutLocation = FLaneGraphLocation();
+	if (IsEmpty())
+		return false;
+
+	const FIntPoint Center = GetCell(Location);
+	const float CenterDistance = FMath::Sqrt(GetCellDistanceSquared(Location, Center.X, Center.Y));
+	const int32 MaxRing = FMath::Max(NumCellsX, NumCellsY);
+
+	float BestDistanceSquared = FMath::Square(FMath::Min(MaxRadius, WORLD_MAX));
+	for (int32 Ring = 0; Ring <= MaxRing; ++Ring)
+	{
+		// No cell of this ring can be closer than the best segment so far
+		const float RingDistance = (Ring - 1) * CellSize - CenterDistance;
+		if (RingDistance > 0.0f && FMath::Square(RingDistance) > BestDistanceSquared)
+			break;
+
+		ForEachCellInRing(Center, Ring, [&](const int32 X, const int32 Y)
+		{
+			if (GetCellDistanceSquared(Location, X, Y) > BestDistanceSquared)
+				return;
+
+			const int32 Cell = GetCellIndex(X, Y);
+			for (int32 Offset = CellOffsets[Cell]; Offset < CellOffsets[Cell + 1]; ++Offset)
+			{
+				const int32 Segment = CellSegments[Offset];
+				const FVector Point =
+					FMath::ClosestPointOnSegment(Location, SegmentStarts[Segment], SegmentEnds[Segment]);
+
+				FLaneGraphLocation Candidate = MakeLocation(Segment, Point);
+				Candidate.DistanceSquared = (Point - Location).SizeSquared();
+				if (Candidate.DistanceSquared <= BestDistanceSquared &&
+					(!OutLocation.IsValid() || IsCloser(Candidate, OutLocation)))
+				{
+					OutLocation = Candidate;
+					BestDistanceSquared = Candidate.DistanceSquared;
+				}
+			}
+		});
+	}
+
+	return OutLocation.IsValid();
+}
+
+void FLaneSpatialIndex::FindInRadius(const FVector& Location, const float Radius,
+									 TArray<FLaneGraphLocation>& OutLocations) const
+{
+	OutLocations.Reset();
+	if (IsEmpty())
+		return;
+
+	const float ClampedRadius = FMath::Min(Radius, WORLD_MAX);
+	const float RadiusSquared = FMath::Square(ClampedRadius);
+	const FIntPoint MinCell = GetCell(Location - FVector(ClampedRadius, ClampedRadius, 0.0f));
+	const FIntPoint MaxCell = GetCell(Location + FVector(ClampedRadius, ClampedRadius, 0.0f));
+	for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+	{
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+		{
+			if (GetCellDistanceSquared(Location, X, Y) > RadiusSquared)
+				continue;
+
+			const int32 Cell = GetCellIndex(X, Y);
+			for (int32 Offset = CellOffsets[Cell]; Offset < CellOffsets[Cell + 1]; ++Offset)
+			{
+				const int32 Segment = CellSegments[Offset];
+				const FVector Point =
+					FMath::ClosestPointOnSegment(Location, SegmentStarts[Segment], SegmentEnds[Segment]);
+				const float DistanceSquared = (Point - Location).SizeSquared();
+				if (DistanceSquared <= RadiusSquared)
+				{
+					FLaneGraphLocation& Result = OutLocations.Add_GetRef(MakeLocation(Segment, Point));
+					Result.DistanceSquared = DistanceSquared;
+				}
+			}
+		}
+	}
+
+	// Segments spanning several cells are found more than once and edges along spline lanes have several segments,
+	// the closest entry of every edge is kept
+	OutLocations.Sort([](const FLaneGraphLocation& A, const FLaneGraphLocation& B)
+	{
+		if (A.FromNode != B.FromNode)
+			return A.FromNode < B.FromNode;
+		if (A.ToNode != B.ToNode)
+			return A.ToNode < B.ToNode;
+		return A.DistanceSquared < B.DistanceSquared;
+	});
+	int32 NumUnique = 0;
+	for (int32 Index = 0; Index < OutLocations.Num(); ++Index)
+	{
+		if (NumUnique > 0 && OutLocations[NumUnique - 1].FromNode == OutLocations[Index].FromNode &&
+			OutLocations[NumUnique - 1].ToNode == OutLocations[Index].ToNode)
+			continue;
+
+		OutLocations[NumUnique++] = OutLocations[Index];
+	}
+	OutLocations.SetNum(NumUnique, false);
+	OutLocations.Sort([](const FLaneGraphLocation& A, const FLaneGraphLocation& B)
+	{
+		return IsCloser(A, B);
+	});
+}
+
+void FLaneSpatialIndex::FindKNearest(const FVector& Location, const int32 Count, const float MaxRadius,
+									 TArray<FLaneGraphLocation>& OutLocations) const
+{
+	OutLocations.Reset();
+	if (IsEmpty() || Count <= 0)
+		return;
+
+	const float MaxDistanceSquared = FMath::Square(FMath::Min(MaxRadius, WORLD_MAX));
+	auto GetWorstDistanceSquared = [&]()
+	{
+		return OutLocations.Num() < Count ? MaxDistanceSquared : OutLocations.Last().DistanceSquared;
+	};
+
+	const FIntPoint Center = GetCell(Location);
+	const float CenterDistance = FMath::Sqrt(GetCellDistanceSquared(Location, Center.X, Center.Y));
+	const int32 MaxRing = FMath::Max(NumCellsX, NumCellsY);
+	for (int32 Ring = 0; Ring <= MaxRing; ++Ring)
+	{
+		const float RingDistance = (Ring - 1) * CellSize - CenterDistance;
+		if (RingDistance > 0.0f && FMath::Square(RingDistance) > GetWorstDistanceSquared())
+			break;
+
+		ForEachCellInRing(Center, Ring, [&](const int32 X, const int32 Y)
+		{
+			if (GetCellDistanceSquared(Location, X, Y) > GetWorstDistanceSquared())
+				return;
+
+			const int32 Cell = GetCellIndex(X, Y);
+			for (int32 Offset = CellOffsets[Cell]; Offset < CellOffsets[Cell + 1]; ++Offset)
+			{
+				const int32 Segment = CellSegments[Offset];
+				const FVector Point =
+					FMath::ClosestPointOnSegment(Location, SegmentStarts[Segment], SegmentEnds[Segment]);
+
+				FLaneGraphLocation Candidate = MakeLocation(Segment, Point);
+				Candidate.DistanceSquared = (Point - Location).SizeSquared();
+				if (Candidate.DistanceSquared > GetWorstDistanceSquared())
+					continue;
+
+				// Another segment of the same edge may have been found already, the closer one is kept
+				const int32 FoundIndex = OutLocations.IndexOfByPredicate([&](const FLaneGraphLocation& Found)
+				{
+					return Found.FromNode == Candidate.FromNode && Found.ToNode == Candidate.ToNode;
+				});
+				if (FoundIndex != INDEX_NONE)
+				{
+					if (!IsCloser(Candidate, OutLocations[FoundIndex]))
+						continue;
+
+					OutLocations.RemoveAt(FoundIndex, 1, false);
+				}
+
+				// Keep the results sorted and at most Count long
+				int32 InsertIndex = OutLocations.Num();
+				while (InsertIndex > 0 && IsCloser(Candidate, OutLocations[InsertIndex - 1]))
+				{
+					--InsertIndex;
+				}
+				OutLocations.Insert(Candidate, InsertIndex);
+				if (OutLocations.Num() > Count)
+					OutLocations.Pop(false);
+			}
+		});
+	}
+}
+
+FIntPoint FLaneSpatialIndex::GetCell(const FVector& Location) const
+{
+	const int32 X = FMath::FloorToInt((Location.X - Origin.X) / CellSize);
+	const int32 Y = FMath::FloorToInt((Location.Y - Origin.Y) / CellSize);
+	return FIntPoint(FMath::Clamp(X, 0, NumCellsX - 1), FMath::Clamp(Y, 0, NumCellsY - 1));
+}
+
+int32 FLaneSpatialIndex::GetCellIndex(const int32 X, const int32 Y) const
+{
+	return Y * NumCellsX + X;
+}
+
+float FLaneSpatialIndex::GetCellDistanceSquared(const FVector& Location, const int32 X, const int32 Y) const
+{
+	const FVector2D CellMin = Origin + FVector2D(X, Y) * CellSize;
+	const FVector2D CellMax = CellMin + FVector2D(CellSize, CellSize);
+	const float DeltaX = FMath::Max3(CellMin.X - Location.X, 0.0f, Location.X - CellMax.X);
+	const float DeltaY = FMath::Max3(CellMin.Y - Location.Y, 0.0f, Location.Y - CellMax.Y);
+	return DeltaX * DeltaX + DeltaY * DeltaY;
+}
+
+void FLaneSpatialIndex::AddSegment(const int32 FromNode, const int32 ToNode, const FVector& Start, const FVector& End,
+								   const float AlphaStart, const float AlphaEnd)
+{
+	SegmentFromNodes.Add(FromNode);
+	SegmentToNodes.Add(ToNode);
+	SegmentStarts.Add(Start);
+	SegmentEnds.Add(End);
+	SegmentAlphaStarts.Add(AlphaStart);
+	SegmentAlphaEnds.Add(AlphaEnd);
+}
+
+FLaneGraphLocation FLaneSpatialIndex::MakeLocation(const int32 Segment, const FVector& Location) const
+{
+	FLaneGraphLocation Result;
+	Result.FromNode = SegmentFromNodes[Segment];
+	Result.ToNode = SegmentToNodes[Segment];
+	Result.Location = Location;
+	Result.Alpha = SegmentAlphaStarts[Segment];
+
+	// The fraction of the edge, not of the segment
+	const FVector Direction = SegmentEnds[Segment] - SegmentStarts[Segment];
+	const float LengthSquared = Direction.SizeSquared();
+	if (LengthSquared > SMALL_NUMBER)
+	{
+		const float SegmentAlpha = FMath::Clamp(
+			FVector::DotProduct(Location - SegmentStarts[Segment], Direction) / LengthSquared, 0.0f, 1.0f);
+		Result.Alpha = FMath::Lerp(SegmentAlphaStarts[Segment], SegmentAlphaEnds[Segment], SegmentAlpha);
+	}
+
+	return Result;
+}
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "LaneGraph.h"
+
+/**
+ * Uniform 2D grid over all segments of a FLaneGraph. Each segment is an edge between two connected nodes, edges
+ * along spline lanes are split into the segments of the lane shape; nodes without any edge are stored as zero
+ * length segments. Queries return the closest point on an edge, not just the closest node, with one result per
+ * edge.
+ */
+class TRAFFICSYSTEM_API FLaneSpatialIndex
+{
+public:
+	void Build(const FLaneGraph& Graph, float InCellSize = 2500.0f);
+	void Reset();
+
+	bool IsEmpty() const;
+	int32 GetNumSegments() const;
+
+	// Closest segment within MaxRadius
+	bool FindNearest(const FVector& Location, float MaxRadius, FLaneGraphLocation& OutLocation) const;
+
+	// All segments within Radius, sorted by distance
+	void FindInRadius(const FVector& Location, float Radius, TArray<FLaneGraphLocation>& OutLocations) const;
+
+	// Up to Count closest segments within MaxRadius, sorted by distance
+	void FindKNearest(const FVector& Location, int32 Count, float MaxRadius,
+					  TArray<FLaneGraphLocation>& OutLocations) const;
+
+protected:
+	FIntPoint GetCell(const FVector& Location) const;
+	int32 GetCellIndex(int32 X, int32 Y) const;
+	float GetCellDistanceSquared(const FVector& Location, int32 X, int32 Y) const;
+
+	void AddSegment(int32 FromNode, int32 ToNode, const FVector& Start, const FVector& End, float AlphaStart,
+					float AlphaEnd);
+	FLaneGraphLocation MakeLocation(int32 Segment, const FVector& Location) const;
+
+	// Calls Visitor(CellX, CellY) for every grid cell with Chebyshev distance Ring to Center
+	template <typename FunctorType>
+	void ForEachCellInRing(const FIntPoint& Center, int32 Ring, FunctorType&& Visitor) const;
+
+	// Segments with the fraction of their edge at both ends, along the shape on spline lanes
+	TArray<int32> SegmentFromNodes;
+	TArray<int32> SegmentToNodes;
+	TArray<FVector> SegmentStarts;
+	TArray<FVector> SegmentEnds;
+	TArray<float> SegmentAlphaStarts;
+	TArray<float> SegmentAlphaEnds;
+
+	// Segments of cell C are CellSegments[CellOffsets[C] .. CellOffsets[C + 1])
+	TArray<int32> CellOffsets;
+	TArray<int32> CellSegments;
+
+	FVector2D Origin = FVector2D::ZeroVector;
+	float CellSize = 2500.0f;
+	int32 NumCellsX = 0;
+	int32 NumCellsY = 0;
+};
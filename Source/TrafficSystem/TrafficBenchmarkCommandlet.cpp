@@ -0,0 +1,227 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficBenchmarkCommandlet.h"
+
+#include "LaneGraph.h"
+#include "TrafficSimulationCore.h"
+
+namespace
+{
+	constexpr float GridSpacing = 10000.0f;
+
+	// Lanes start and end this far from the center of the intersections
+	constexpr float IntersectionRadius = 1000.0f;
+
+	// Distance of a lane to the right of the line between the intersections
+	constexpr float LaneOffset = 175.0f;
+
+	constexpr int32 WaypointsPerLane = 9;
+
+	constexpr float GreenDuration = 20.0f;
+	constexpr float ClearanceDuration = 3.0f;
+
+	// Steps between two vehicles added while verifying the replay
+	constexpr int32 ReplayInputInterval = 10;
+
+	// Changes with the model, not with the number of threads
+	uint32 CalculateStateChecksum(const FTrafficSimulationCore& Simulation)
+	{
+		const FTrafficVehicleState& State = Simulation.GetVehicleState();
+		uint32 Checksum = FCrc::MemCrc32(State.Handles.GetData(), State.Handles.Num() * State.Handles.GetTypeSize());
+		Checksum = FCrc::MemCrc32(State.Locations.GetData(), State.Locations.Num() * State.Locations.GetTypeSize(),
+								  Checksum);
+		return FCrc::MemCrc32(State.Speeds.GetData(), State.Speeds.Num() * State.Speeds.GetTypeSize(), Checksum);
+	}
+}
+
+UTrafficBenchmarkCommandlet::UTrafficBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UTrafficBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 GridSize = 10;
+	int32 NumVehicles = 2000;
+	float Seconds = 600.0f;
+	float StepSeconds = 0.1f;
+	int32 RandomSeed = 1337;
+	FParse::Value(*Params, TEXT("Grid="), GridSize);
+	FParse::Value(*Params, TEXT("Vehicles="), NumVehicles);
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+	FParse::Value(*Params, TEXT("Step="), StepSeconds);
+	FParse::Value(*Params, TEXT("Seed="), RandomSeed);
+	GridSize = FMath::Max(GridSize, 2);
+	StepSeconds = FMath::Max(StepSeconds, KINDA_SMALL_NUMBER);
+
+	TArray<FLaneGraphLane> Lanes;
+	TArray<TArray<int32>> SignalNodes;
+	BuildGrid(GridSize, Lanes, SignalNodes);
+
+	const TSharedRef<FLaneGraph, ESPMode::ThreadSafe> Graph = MakeShared<FLaneGraph, ESPMode::ThreadSafe>();
+	FLaneGraph::Build(Lanes, *Graph);
+
+	FTrafficSimulationCore Simulation;
+	Simulation.Initialize(Graph, RandomSeed);
+	Simulation.bParallel = !FParse::Param(*Params, TEXT("SingleThread"));
+	AddGridSignals(SignalNodes, Simulation);
+
+	// Fill the lanes one waypoint after the other so vehicles only overlap on crowded grids
+	const int32 NumLanes = Graph->GetNumLanes();
+	for (int32 Vehicle = 0; Vehicle < NumVehicles; ++Vehicle)
+	{
+		const int32 Lane = Vehicle % NumLanes;
+		const int32 WaypointIndex = (Vehicle / NumLanes) % Graph->LaneNumNodes[Lane];
+		Simulation.AddVehicle(Graph->GetNodeIndex(Lane, WaypointIndex));
+	}
+
+	UE_LOG(LogTemp, Display,
+		   TEXT("Traffic benchmark: %dx%d grid, %d nodes, %d conflicts, %d vehicles, %.0f s in steps of %.3f s%s"),
+		   GridSize, GridSize, Graph->GetNumNodes(), Graph->ConflictEdges.Num() / 2, Simulation.GetNumVehicles(),
+		   Seconds, StepSeconds, Simulation.bParallel ? TEXT("") : TEXT(", single thread"));
+
+	const int32 NumSteps = FMath::CeilToInt(Seconds / StepSeconds);
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Step = 0; Step < NumSteps; ++Step)
+	{
+		Simulation.Step(StepSeconds);
+	}
+	const double WallSeconds = FMath::Max(FPlatformTime::Seconds() - StartTime, SMALL_NUMBER);
+
+	UE_LOG(LogTemp, Display, TEXT("Simulated %.0f vehicle-seconds in %.3f s: %.0f vehicle-seconds per second"),
+		   Simulation.GetVehicleSeconds(), WallSeconds, Simulation.GetVehicleSeconds() / WallSeconds);
+	UE_LOG(LogTemp, Display, TEXT("%d vehicles left, %lld arrived, checksum %08x"), Simulation.GetNumVehicles(),
+		   Simulation.GetNumArrivedVehicles(), CalculateStateChecksum(Simulation));
+
+	if (FParse::Param(*Params, TEXT("VerifyReplay")) && !VerifyReplay(Simulation, NumSteps, StepSeconds))
+		return 1;
+
+	return 0;
+}
+
+bool UTrafficBenchmarkCommandlet::VerifyReplay(FTrafficSimulationCore& Simulation, const int32 NumSteps,
+											   const float StepSeconds)
+{
+	TArray<uint8> Snapshot;
+	double StartTime = FPlatformTime::Seconds();
+	Simulation.SaveSnapshot(Snapshot);
+	const double SaveSeconds = FPlatformTime::Seconds() - StartTime;
+
+	// Record a run with inputs from the outside
+	const int64 EndStep = Simulation.GetNumSteps() + NumSteps;
+	const FLaneGraph& Graph = *Simulation.GetLaneGraph();
+	FRandomStream InputStream(Simulation.GetNumSteps());
+	Simulation.SetRecordInputs(true);
+	while (Simulation.GetNumSteps() < EndStep)
+	{
+		if (Simulation.GetNumSteps() % ReplayInputInterval == 0)
+			Simulation.AddVehicle(Graph.GetNodeIndex(InputStream.RandHelper(Graph.GetNumLanes()), 0));
+
+		Simulation.Step(StepSeconds);
+	}
+	Simulation.SetRecordInputs(false);
+	const uint32 RecordedChecksum = CalculateStateChecksum(Simulation);
+	const TArray<FTrafficSimulationInput>& Inputs = Simulation.GetRecordedInputs();
+
+	StartTime = FPlatformTime::Seconds();
+	const bool bLoaded = Simulation.LoadSnapshot(Snapshot);
+	const double LoadSeconds = FPlatformTime::Seconds() - StartTime;
+	if (bLoaded)
+		Simulation.Replay(Inputs, EndStep, StepSeconds);
+
+	const uint32 ReplayedChecksum = CalculateStateChecksum(Simulation);
+	UE_LOG(LogTemp, Display, TEXT("Snapshot of %d bytes saved in %.3f ms, loaded in %.3f ms, %d inputs replayed"),
+		   Snapshot.Num(), SaveSeconds * 1000.0, LoadSeconds * 1000.0, Inputs.Num());
+
+	if (!bLoaded || RecordedChecksum != ReplayedChecksum)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Replay diverged: checksum %08x, recorded %08x"), ReplayedChecksum,
+			   RecordedChecksum);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Replay matches the recorded run, checksum %08x"), ReplayedChecksum);
+	return true;
+}
+
+void UTrafficBenchmarkCommandlet::BuildGrid(const int32 GridSize, TArray<FLaneGraphLane>& OutLanes,
+											TArray<TArray<int32>>& OutSignalNodes)
+{
+	OutLanes.Reset();
+	OutSignalNodes.Reset();
+	OutSignalNodes.SetNum(GridSize * GridSize * 2);
+
+	// A lane from every intersection to each of its neighbours
+	const FIntPoint Directions[] = { FIntPoint(1, 0), FIntPoint(0, 1), FIntPoint(-1, 0), FIntPoint(0, -1) };
+	TArray<FIntPoint> LaneFrom;
+	TArray<FIntPoint> LaneTo;
+	for (int32 Y = 0; Y < GridSize; ++Y)
+	{
+		for (int32 X = 0; X < GridSize; ++X)
+		{
+			for (const FIntPoint& Direction : Directions)
+			{
+				const FIntPoint To(X + Direction.X, Y + Direction.Y);
+				if (To.X < 0 || To.Y < 0 || To.X >= GridSize || To.Y >= GridSize)
+					continue;
+
+				LaneFrom.Add(FIntPoint(X, Y));
+				LaneTo.Add(To);
+			}
+		}
+	}
+
+	OutLanes.SetNum(LaneFrom.Num());
+	for (int32 Lane = 0; Lane < LaneFrom.Num(); ++Lane)
+	{
+		const FVector From(LaneFrom[Lane].X * GridSpacing, LaneFrom[Lane].Y * GridSpacing, 0.0f);
+		const FVector To(LaneTo[Lane].X * GridSpacing, LaneTo[Lane].Y * GridSpacing, 0.0f);
+		const FVector Forward = (To - From).GetSafeNormal();
+		const FVector Right(-Forward.Y, Forward.X, 0.0f);
+		const FVector Start = From + Forward * IntersectionRadius + Right * LaneOffset;
+		const FVector End = To - Forward * IntersectionRadius + Right * LaneOffset;
+
+		TArray<FLaneGraphWaypoint>& Waypoints = OutLanes[Lane].Waypoints;
+		Waypoints.SetNum(WaypointsPerLane);
+		for (int32 WaypointIndex = 0; WaypointIndex < WaypointsPerLane; ++WaypointIndex)
+		{
+			Waypoints[WaypointIndex].Location =
+				FMath::Lerp(Start, End, static_cast<float>(WaypointIndex) / (WaypointsPerLane - 1));
+			if (WaypointIndex + 1 < WaypointsPerLane)
+				Waypoints[WaypointIndex].OutConnections.Add(FIntPoint(Lane, WaypointIndex + 1));
+		}
+
+		// The end of the lane turns into every lane leaving the intersection except the way back
+		for (int32 NextLane = 0; NextLane < LaneFrom.Num(); ++NextLane)
+		{
+			if (LaneFrom[NextLane] == LaneTo[Lane] && LaneTo[NextLane] != LaneFrom[Lane])
+				Waypoints.Last().OutConnections.Add(FIntPoint(NextLane, 0));
+		}
+
+		const int32 Intersection = LaneTo[Lane].Y * GridSize + LaneTo[Lane].X;
+		const int32 Axis = LaneFrom[Lane].Y == LaneTo[Lane].Y ? 0 : 1;
+		OutSignalNodes[Intersection * 2 + Axis].Add(Lane * WaypointsPerLane + WaypointsPerLane - 1);
+	}
+}
+
+void UTrafficBenchmarkCommandlet::AddGridSignals(const TArray<TArray<int32>>& SignalNodes,
+												 FTrafficSimulationCore& Simulation)
+{
+	TArray<FTrafficSignalPhase> Phases;
+	Phases.SetNum(2);
+	for (int32 Intersection = 0; Intersection < SignalNodes.Num() / 2; ++Intersection)
+	{
+		for (int32 Axis = 0; Axis < 2; ++Axis)
+		{
+			Phases[Axis].Signals = { Simulation.AddSignal(SignalNodes[Intersection * 2 + Axis], true) };
+			Phases[Axis].GoDuration = GreenDuration;
+			Phases[Axis].WaitDuration = ClearanceDuration;
+		}
+
+		Simulation.GetSignalScheduler().AddPlan(Phases, 0.0);
+	}
+}
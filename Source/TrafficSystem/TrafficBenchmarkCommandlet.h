@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TrafficBenchmarkCommandlet.generated.h"
+
+struct FLaneGraphLane;
+class FTrafficSimulationCore;
+
+/**
+ * Runs FTrafficSimulationCore on a synthetic grid of signalized intersections without loading a map and logs
+ * the simulated vehicle-seconds per second.
+ *
+ * UE4Editor-Cmd.exe <Project> -run=TrafficBenchmark [-Grid=10] [-Vehicles=2000] [-Seconds=600] [-Step=0.1]
+ *     [-Seed=1337] [-SingleThread] [-VerifyReplay]
+ */
+UCLASS()
+class TRAFFICSYSTEM_API UTrafficBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTrafficBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+	// Two-way lanes between GridSize x GridSize intersections, every lane ends at a signal. OutSignalNodes gets
+	// the last node of the lanes ending at each intersection, east-west and north-south lanes alternating.
+	static void BuildGrid(int32 GridSize, TArray<FLaneGraphLane>& OutLanes, TArray<TArray<int32>>& OutSignalNodes);
+
+	// One fixed plan per intersection switching between its two signals
+	static void AddGridSignals(const TArray<TArray<int32>>& SignalNodes, FTrafficSimulationCore& Simulation);
+
+	// Records NumSteps more steps with added vehicles, then loads a snapshot taken before them and replays the
+	// inputs. Fails unless the replay ends in the recorded state.
+	static bool VerifyReplay(FTrafficSimulationCore& Simulation, int32 NumSteps, float StepSeconds);
+};
@@ -0,0 +1,178 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficCorridor.h"
+
+#include "Lane.h"
+#include "LaneGraph.h"
+#include "LaneRoutePlanner.h"
+#include "TrafficLight.h"
+#include "TrafficLightsController.h"
+
+namespace
+{
+	// FWaypoint::TargetSpeed is given in km/h
+	constexpr float KilometersPerHourToCentimetersPerSecond = 100000.0f / 3600.0f;
+
+	// Keeps waypoints without a target speed from stretching the travel time indefinitely
+	constexpr float MinProgressionSpeed = 10.0f;
+
+	void GatherGroupNodes(const FLaneGraph& Graph, const TArray<ALane*>& Lanes,
+						  const FTrafficCorridorIntersection& Intersection, TArray<int32>& OutNodes)
+	{
+		OutNodes.Reset();
+		const TArray<FTrafficLightGroup> Groups = Intersection.Controller->GetGroups();
+		if (!Groups.IsValidIndex(Intersection.GroupIndex))
+			return;
+
+		for (const ATrafficLight* TrafficLight : Groups[Intersection.GroupIndex].TrafficLights)
+		{
+			if (!IsValid(TrafficLight))
+				continue;
+
+			for (const FConnection& ConnectedWaypoint : TrafficLight->ConnectedWaypoints)
+			{
+				const ALane* Lane = ConnectedWaypoint.Lane.Get();
+				const int32 LaneIndex = Lanes.IndexOfByKey(Lane);
+				if (LaneIndex == INDEX_NONE || !Lane->HasWaypointId(ConnectedWaypoint.Id))
+					continue;
+
+				const int32 WaypointIndex = Lane->GetWaypointIndex(ConnectedWaypoint.Id);
+				if (WaypointIndex < Graph.LaneNumNodes[LaneIndex])
+					OutNodes.Add(Graph.GetNodeIndex(LaneIndex, WaypointIndex));
+			}
+		}
+	}
+
+	float CalculateTravelTime(const FLaneGraph& Graph, const TArray<int32>& Route)
+	{
+		float TravelTime = 0.0f;
+		for (int32 Step = 1; Step < Route.Num(); ++Step)
+		{
+			const int32 From = Route[Step - 1];
+			const int32 To = Route[Step];
+			for (int32 Edge = Graph.OutOffsets[From]; Edge < Graph.OutOffsets[From + 1]; ++Edge)
+			{
+				if (Graph.OutTargets[Edge] != To)
+					continue;
+
+				const float Speed = FMath::Max(Graph.TargetSpeeds[To], MinProgressionSpeed);
+				TravelTime += Graph.OutLengths[Edge] / (Speed * KilometersPerHourToCentimetersPerSecond);
+				break;
+			}
+		}
+
+		return TravelTime;
+	}
+}
+
+ATrafficCorridor::ATrafficCorridor()
+{
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneComponent"));
+
+	PrimaryActorTick.bCanEverTick = false;
+	SetActorHiddenInGame(true);
+
+	CycleLengthOverride = 0.0f;
+	bBuildOnSave = false;
+	CycleLength = 0.0f;
+}
+
+void ATrafficCorridor::BuildGreenWave()
+{
+	Modify();
+	ClearGreenWave();
+
+	// The corridor stays unbuilt unless every intersection has a controller
+	float MaxCycleLength = CycleLengthOverride;
+	for (const FTrafficCorridorIntersection& Intersection : Intersections)
+	{
+		if (!IsValid(Intersection.Controller))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s has an intersection without a controller"), *GetName());
+			return;
+		}
+
+		MaxCycleLength = FMath::Max(MaxCycleLength, CalculateCycleLength(*Intersection.Controller));
+	}
+	CycleLength = MaxCycleLength;
+
+	TArray<ALane*> Lanes;
+	FLaneGraph::GatherLanes(GetWorld(), Lanes);
+
+	FLaneGraph Graph;
+	FLaneGraph::Build(Lanes, Graph);
+
+	// Every group goes when the vehicles let through by the previous one arrive on the fastest route
+	FLaneRoutePlanner Planner;
+	TArray<int32> FromNodes;
+	TArray<int32> ToNodes;
+	TArray<int32> Route;
+	double Progression = 0.0;
+	for (int32 Index = 1; Index < Intersections.Num(); ++Index)
+	{
+		GatherGroupNodes(Graph, Lanes, Intersections[Index - 1], FromNodes);
+		GatherGroupNodes(Graph, Lanes, Intersections[Index], ToNodes);
+
+		float TravelTime = MAX_FLT;
+		for (const int32 FromNode : FromNodes)
+		{
+			for (const int32 ToNode : ToNodes)
+			{
+				if (Planner.FindRoute(Graph, FromNode, ToNode, Route))
+					TravelTime = FMath::Min(TravelTime, CalculateTravelTime(Graph, Route));
+			}
+		}
+
+		if (TravelTime == MAX_FLT)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s: no route from %s to %s, both go at the same time"), *GetName(),
+				   *Intersections[Index - 1].Controller->GetName(), *Intersections[Index].Controller->GetName());
+			TravelTime = 0.0f;
+		}
+
+		Progression += TravelTime;
+		Intersections[Index].Offset = CycleLength > 0.0f ? FMath::Fmod(Progression, CycleLength) : 0.0f;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Built green wave %s over %d intersections, cycle %.1f s, progression %.1f s"),
+		   *GetName(), Intersections.Num(), CycleLength, Progression);
+}
+
+void ATrafficCorridor::ClearGreenWave()
+{
+	Modify();
+
+	CycleLength = 0.0f;
+	for (FTrafficCorridorIntersection& Intersection : Intersections)
+	{
+		Intersection.Offset = 0.0f;
+	}
+}
+
+bool ATrafficCorridor::IsBuilt() const
+{
+	return CycleLength > 0.0f;
+}
+
+float ATrafficCorridor::CalculateCycleLength(const ATrafficLightsController& Controller)
+{
+	float Cycle = 0.0f;
+	for (const FTrafficLightGroup& Group : Controller.GetGroups())
+	{
+		Cycle += Group.GoDuration + Group.WaitAfterStopDuration;
+	}
+
+	return Cycle;
+}
+
+#if WITH_EDITOR
+void ATrafficCorridor::PreSave(const ITargetPlatform* TargetPlatform)
+{
+	Super::PreSave(TargetPlatform);
+
+	const UWorld* World = GetWorld();
+	if (bBuildOnSave && World && !World->IsGameWorld())
+		BuildGreenWave();
+}
+#endif
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "GameFramework/Actor.h"
+#include "TrafficCorridor.generated.h"
+
+class ATrafficLightsController;
+
+USTRUCT(BlueprintType)
+struct FTrafficCorridorIntersection
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditInstanceOnly, BlueprintReadWrite)
+	ATrafficLightsController* Controller = nullptr;
+
+	// Group of the controller letting the corridor through
+	UPROPERTY(EditInstanceOnly, BlueprintReadWrite, meta = (ClampMin = 0))
+	int32 GroupIndex = 0;
+
+	// Time into the common cycle at which the group goes, computed by BuildGreenWave
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	float Offset = 0.0f;
+};
+
+/**
+ * Coordinates the fixed time traffic lights along a corridor into a green wave. All controllers run the
+ * same cycle and the corridor group of each one goes when vehicles let through by the previous intersection
+ * arrive at the target speeds of the lanes in between. Offsets are computed in the editor from the lane graph
+ * and applied by the traffic simulation at BeginPlay.
+ */
+UCLASS(NotBlueprintable)
+class TRAFFICSYSTEM_API ATrafficCorridor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ATrafficCorridor();
+
+	// Intersections in driving direction
+	UPROPERTY(EditInstanceOnly, Category = "Green Wave")
+	TArray<FTrafficCorridorIntersection> Intersections;
+
+	// Common cycle of all controllers, at least the longest cycle of them. Zero uses the longest cycle.
+	UPROPERTY(EditInstanceOnly, Category = "Green Wave", meta = (ClampMin = 0))
+	float CycleLengthOverride;
+
+	// Recomputes the offsets whenever the level is saved or cooked
+	UPROPERTY(EditAnywhere, Category = "Green Wave")
+	bool bBuildOnSave;
+
+	UPROPERTY(VisibleAnywhere, Category = "Green Wave")
+	float CycleLength;
+
+	UFUNCTION(CallInEditor, Category = "Green Wave")
+	void BuildGreenWave();
+
+	UFUNCTION(CallInEditor, Category = "Green Wave")
+	void ClearGreenWave();
+
+	// False until the offsets are built
+	bool IsBuilt() const;
+
+	// Natural cycle of a controller, the sum of the go and wait durations of all groups
+	static float CalculateCycleLength(const ATrafficLightsController& Controller);
+
+#if WITH_EDITOR
+	virtual void PreSave(const class ITargetPlatform* TargetPlatform) override;
+#endif
+};
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficLandmarkData.h"
+
+#include "LaneGraph.h"
+
+ATrafficLandmarkData::ATrafficLandmarkData()
+{
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneComponent"));
+
+	PrimaryActorTick.bCanEverTick = false;
+	SetActorHiddenInGame(true);
+
+	NumLandmarks = 16;
+	bBuildOnSave = false;
+	BuildTimeSeconds = 0.0f;
+	MemoryKilobytes = 0;
+}
+
+void ATrafficLandmarkData::BuildLandmarks()
+{
+	Modify();
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<ALane*> Lanes;
+	FLaneGraph::GatherLanes(GetWorld(), Lanes);
+
+	FLaneGraph Graph;
+	FLaneGraph::Build(Lanes, Graph);
+	FLaneLandmarks::Build(Graph, NumLandmarks, Landmarks);
+
+	BuildTimeSeconds = FPlatformTime::Seconds() - StartTime;
+	MemoryKilobytes = Landmarks.GetAllocatedSize() / 1024;
+
+	UE_LOG(LogTemp, Log, TEXT("Built %d route landmarks for %d lane graph nodes in %.2f s, %d KB"),
+		   Landmarks.GetNumLandmarks(), Graph.GetNumNodes(), BuildTimeSeconds, MemoryKilobytes);
+}
+
+void ATrafficLandmarkData::ClearLandmarks()
+{
+	Modify();
+
+	Landmarks.Reset();
+	BuildTimeSeconds = 0.0f;
+	MemoryKilobytes = 0;
+}
+
+const FLaneLandmarks& ATrafficLandmarkData::GetLandmarks() const
+{
+	return Landmarks;
+}
+
+#if WITH_EDITOR
+void ATrafficLandmarkData::PreSave(const ITargetPlatform* TargetPlatform)
+{
+	Super::PreSave(TargetPlatform);
+
+	const UWorld* World = GetWorld();
+	if (bBuildOnSave && World && !World->IsGameWorld())
+		BuildLandmarks();
+}
+#endif
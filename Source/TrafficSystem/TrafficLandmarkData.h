@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "LaneLandmarks.h"
+#include "GameFramework/Actor.h"
+#include "TrafficLandmarkData.generated.h"
+
+/**
+ * Stores the route planning landmark tables of a level. Place one in the level and build the tables in the
+ * editor after editing lanes; the traffic simulation ignores tables that were built for a different lane graph.
+ */
+UCLASS(NotBlueprintable)
+class TRAFFICSYSTEM_API ATrafficLandmarkData : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ATrafficLandmarkData();
+
+	// More landmarks give tighter estimates at the cost of memory and a slower heuristic
+	UPROPERTY(EditAnywhere, Category = "Landmarks", meta = (ClampMin = 1, ClampMax = 64))
+	int32 NumLandmarks;
+
+	// Rebuilds the tables whenever the level is saved or cooked
+	UPROPERTY(EditAnywhere, Category = "Landmarks")
+	bool bBuildOnSave;
+
+	UPROPERTY(VisibleAnywhere, Category = "Landmarks|Stats")
+	float BuildTimeSeconds;
+
+	UPROPERTY(VisibleAnywhere, Category = "Landmarks|Stats")
+	int32 MemoryKilobytes;
+
+	UFUNCTION(CallInEditor, Category = "Landmarks")
+	void BuildLandmarks();
+
+	UFUNCTION(CallInEditor, Category = "Landmarks")
+	void ClearLandmarks();
+
+	const FLaneLandmarks& GetLandmarks() const;
+
+#if WITH_EDITOR
+	virtual void PreSave(const class ITargetPlatform* TargetPlatform) override;
+#endif
+
+protected:
+	UPROPERTY()
+	FLaneLandmarks Landmarks;
+};
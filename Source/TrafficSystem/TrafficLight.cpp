@@ -3,6 +3,8 @@
 
 #include "TrafficLight.h"
 
+#include "TrafficSimulationSubsystem.h"
+
 // Sets default values
 ATrafficLight::ATrafficLight()
 {
@@ -17,6 +19,16 @@ ATrafficLight::ATrafficLight()
 void ATrafficLight::SetStop(const bool bStopFlag)
 {
 	bStop = bStopFlag;
+
+	// During play the stop state lives in a signal of the simulation
+	const UWorld* World = GetWorld();
+	UTrafficSimulationSubsystem* Simulation = World ? World->GetSubsystem<UTrafficSimulationSubsystem>() : nullptr;
+	if (Simulation && Simulation->HasLaneGraph())
+	{
+		Simulation->SetSignalStop(SignalIndex, bStopFlag);
+		return;
+	}
+
 	for (const auto& ConnectedWaypoint : ConnectedWaypoints)
 	{
 		if (ConnectedWaypoint.Lane.IsValid())
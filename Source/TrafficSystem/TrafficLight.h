@@ -23,6 +23,10 @@ public:
 	UPROPERTY(EditInstanceOnly, BlueprintReadWrite)
 	TArray<FConnection> ConnectedWaypoints;
 
+	// Signal of the traffic simulation governing the connected waypoints, assigned at BeginPlay
+	UPROPERTY(VisibleInstanceOnly, Transient)
+	int32 SignalIndex = INDEX_NONE;
+
 	UFUNCTION(BlueprintCallable)
 	void SetStop(bool bStopFlag);
 
@@ -10,79 +10,15 @@ ATrafficLightsController::ATrafficLightsController()
 {
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneComponent"));
 	
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// The phases are cycled by the signal scheduler of the traffic simulation
+	PrimaryActorTick.bCanEverTick = false;
 
-	CurrentGroupIndex = -1;
+	Timing = ETrafficSignalTiming::Fixed;
+	MinGoDuration = 5.0f;
+	ExtensionInterval = 1.0f;
 }
 
 TArray<FTrafficLightGroup> ATrafficLightsController::GetGroups() const
 {
 	return Groups;
 }
-
-// Called when the game starts or when spawned
-void ATrafficLightsController::BeginPlay()
-{
-	Super::BeginPlay();
-
-	// Set all Groups to stop
-	for (FTrafficLightGroup& Group : Groups)
-	{
-		for (ATrafficLight* TrafficLight : Group.TrafficLights)
-		{
-			if (TrafficLight->IsPendingKill())
-				continue;
-
-			TrafficLight->SetStop(true);
-		}
-	}
-	
-	if (Groups.Num() > 0)
-	{
-		WaitDurationExpired();
-	}
-}
-
-void ATrafficLightsController::EndPlay(const EEndPlayReason::Type EndPlayReason)
-{
-	GetWorldTimerManager().ClearAllTimersForObject(this);
-}
-
-void ATrafficLightsController::SetStopStateForGroup(const FTrafficLightGroup& Group, bool bStopFlag)
-{
-	for (ATrafficLight* TrafficLight : Group.TrafficLights)
-	{
-		if (TrafficLight->IsPendingKill())
-			continue;
-
-		TrafficLight->SetStop(bStopFlag);
-	}
-}
-
-void ATrafficLightsController::GoDurationExpired()
-{
-	const FTrafficLightGroup& Group = Groups[CurrentGroupIndex];
-	SetStopStateForGroup(Group, true);
-	GetWorldTimerManager().SetTimer(TimerHandle, this, &ATrafficLightsController::WaitDurationExpired,
-									Group.WaitAfterStopDuration, false);
-}
-
-void ATrafficLightsController::WaitDurationExpired()
-{	
-	CurrentGroupIndex += 1;
-	if (CurrentGroupIndex >= Groups.Num())
-		CurrentGroupIndex = 0;
-
-	const FTrafficLightGroup& Group = Groups[CurrentGroupIndex];	
-	SetStopStateForGroup(Group, false);
-	GetWorldTimerManager().SetTimer(TimerHandle, this, &ATrafficLightsController::GoDurationExpired, Group.GoDuration,
-									false);
-}
-
-// Called every frame
-void ATrafficLightsController::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
-}
-
@@ -9,6 +9,17 @@
 
 class ATrafficLight;
 
+UENUM(BlueprintType)
+enum class ETrafficSignalTiming : uint8
+{
+	// Groups go in order for their GoDuration
+	Fixed,
+
+	// The group with the longest queue goes and keeps going while it has the longest queue, GoDuration is the
+	// longest a group goes at once
+	MaxPressure
+};
+
 USTRUCT(BlueprintType)
 struct FTrafficLightGroup
 {
@@ -31,6 +42,11 @@ struct FTrafficLightGroup
 	{}
 };
 
+/**
+ * Switches its groups of traffic lights: one group goes, then all stop for WaitAfterStopDuration before the
+ * next group goes. The groups are read by the traffic simulation at BeginPlay and switched by its signal
+ * scheduler together with all other controllers.
+ */
 UCLASS()
 class TRAFFICSYSTEM_API ATrafficLightsController : public AActor
 {
@@ -41,27 +57,21 @@ public:
 	ATrafficLightsController();
 
 	TArray<FTrafficLightGroup> GetGroups() const;
-	
-protected:
-	// Called when the game starts or when spawned
-	virtual void BeginPlay() override;
-	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-	static void SetStopStateForGroup(const FTrafficLightGroup& Group, bool bStopFlag);
+	UPROPERTY(EditInstanceOnly, BlueprintReadWrite)
+	ETrafficSignalTiming Timing;
+
+	// Shortest go of a group with max pressure timing, afterwards it is extended in steps of ExtensionInterval
+	UPROPERTY(EditInstanceOnly, BlueprintReadWrite, meta = (EditCondition = "Timing == ETrafficSignalTiming::MaxPressure"))
+	float MinGoDuration;
 
+	UPROPERTY(EditInstanceOnly, BlueprintReadWrite, meta = (EditCondition = "Timing == ETrafficSignalTiming::MaxPressure"))
+	float ExtensionInterval;
+	
+protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	class USceneComponent* SceneComponent;
 
 	UPROPERTY(EditInstanceOnly, BlueprintReadWrite)
 	TArray<FTrafficLightGroup> Groups;
-
-	void GoDurationExpired();
-	void WaitDurationExpired();
-	
-	FTimerHandle TimerHandle;
-	int32 CurrentGroupIndex;
-	
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
 };
@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficReservationManager.h"
+
+#include "LaneGraph.h"
+#include "TrafficSerialization.h"
+
+void FTrafficReservationManager::Reset(const int32 NumEdges)
+{
+	HandleEdges.Reset();
+	ReservedHandles.Reset();
+	EdgeFirstGrants.Init(INDEX_NONE, NumEdges);
+	NextGrants.Reset();
+	GrantedEdges.Reset();
+	Order.Reset();
+	ArrivalTimes.Reset();
+}
+
+void FTrafficReservationManager::Update(const FLaneGraph& Graph, const TArrayView<FTrafficReservationRequest> Requests)
+{
+	for (const int32 Handle : ReservedHandles)
+	{
+		HandleEdges[Handle] = INDEX_NONE;
+	}
+	ReservedHandles.Reset();
+
+	if (EdgeFirstGrants.Num() != Graph.OutTargets.Num())
+		EdgeFirstGrants.Init(INDEX_NONE, Graph.OutTargets.Num());
+
+	Order.Reset(Requests.Num());
+	ArrivalTimes.Reset(Requests.Num());
+	for (int32 RequestIndex = 0; RequestIndex < Requests.Num(); ++RequestIndex)
+	{
+		FTrafficReservationRequest& Request = Requests[RequestIndex];
+		Request.bGranted = false;
+		Order.Add(RequestIndex);
+		ArrivalTimes.Add(CalculateTravelTime(Request.Distance, Request.Speed, Request.MaxSpeed));
+	}
+
+	// The handle decides between equal requests, so the result does not depend on the order of the vehicles
+	Order.Sort([this, Requests](const int32 A, const int32 B)
+	{
+		const FTrafficReservationRequest& RequestA = Requests[A];
+		const FTrafficReservationRequest& RequestB = Requests[B];
+		if (RequestA.bCommitted != RequestB.bCommitted)
+			return RequestA.bCommitted;
+		if (RequestA.Priority != RequestB.Priority)
+			return RequestA.Priority > RequestB.Priority;
+		if (ArrivalTimes[A] != ArrivalTimes[B])
+			return ArrivalTimes[A] < ArrivalTimes[B];
+		return RequestA.Handle < RequestB.Handle;
+	});
+
+	NextGrants.SetNumUninitialized(Requests.Num(), false);
+	for (const int32 RequestIndex : Order)
+	{
+		FTrafficReservationRequest& Request = Requests[RequestIndex];
+		if (Request.bYielding || (!Request.bCommitted && HasConflict(Graph, Requests, Request)))
+			continue;
+
+		Request.bGranted = true;
+		if (EdgeFirstGrants[Request.Edge] == INDEX_NONE)
+			GrantedEdges.Add(Request.Edge);
+		NextGrants[RequestIndex] = EdgeFirstGrants[Request.Edge];
+		EdgeFirstGrants[Request.Edge] = RequestIndex;
+
+		const int32 NumHandles = HandleEdges.Num();
+		if (Request.Handle >= NumHandles)
+		{
+			HandleEdges.SetNumUninitialized(Request.Handle + 1);
+			for (int32 Handle = NumHandles; Handle < HandleEdges.Num(); ++Handle)
+			{
+				HandleEdges[Handle] = INDEX_NONE;
+			}
+		}
+		HandleEdges[Request.Handle] = Request.Edge;
+		ReservedHandles.Add(Request.Handle);
+	}
+
+	for (const int32 Edge : GrantedEdges)
+	{
+		EdgeFirstGrants[Edge] = INDEX_NONE;
+	}
+	GrantedEdges.Reset();
+}
+
+int32 FTrafficReservationManager::GetReservedEdge(const int32 Handle) const
+{
+	return HandleEdges.IsValidIndex(Handle) ? HandleEdges[Handle] : INDEX_NONE;
+}
+
+void FTrafficReservationManager::Release(const int32 Handle)
+{
+	if (HandleEdges.IsValidIndex(Handle))
+		HandleEdges[Handle] = INDEX_NONE;
+}
+
+TArrayView<const int32> FTrafficReservationManager::GetReservedHandles() const
+{
+	return ReservedHandles;
+}
+
+void FTrafficReservationManager::Serialize(FArchive& Ar)
+{
+	// The lists per edge only live during an update
+	TrafficSerialization::SerializeArray(Ar, HandleEdges);
+	TrafficSerialization::SerializeArray(Ar, ReservedHandles);
+}
+
+float FTrafficReservationManager::CalculateTravelTime(const float Distance, const float Speed,
+													  const float MaxSpeed) const
+{
+	if (Distance <= 0.0f)
+		return Distance / FMath::Max(Speed, MinSpeed);
+
+	// Vehicles faster than the edge allows slow down to it
+	const float TargetSpeed = FMath::Max(MaxSpeed, MinSpeed);
+	const float StartSpeed = FMath::Max(Speed, 0.0f);
+	if (StartSpeed >= TargetSpeed)
+		return Distance / TargetSpeed;
+
+	// Accelerate to the target speed and keep it
+	const float AccelerationDistance =
+		(FMath::Square(TargetSpeed) - FMath::Square(StartSpeed)) / (2.0f * Acceleration);
+	if (Distance < AccelerationDistance)
+		return (FMath::Sqrt(FMath::Square(StartSpeed) + 2.0f * Acceleration * Distance) - StartSpeed) / Acceleration;
+
+	return (TargetSpeed - StartSpeed) / Acceleration + (Distance - AccelerationDistance) / TargetSpeed;
+}
+
+bool FTrafficReservationManager::HasConflict(const FLaneGraph& Graph,
+											 const TArrayView<const FTrafficReservationRequest> Requests,
+											 const FTrafficReservationRequest& Request) const
+{
+	const float HalfClearance = 0.5f * ClearanceDistance;
+	for (int32 Conflict = Graph.ConflictOffsets[Request.Edge]; Conflict < Graph.ConflictOffsets[Request.Edge + 1];
+		 ++Conflict)
+	{
+		int32 Granted = EdgeFirstGrants[Graph.ConflictEdges[Conflict]];
+		if (Granted == INDEX_NONE)
+			continue;
+
+		// Time on the conflict point, vehicles past it have left it before now
+		const float Point = Request.Distance + Graph.ConflictDistances[Conflict];
+		const float Enter = CalculateTravelTime(Point - HalfClearance, Request.Speed, Request.MaxSpeed) - TimeMargin;
+		const float Exit = CalculateTravelTime(Point + HalfClearance, Request.Speed, Request.MaxSpeed) + TimeMargin;
+		for (; Granted != INDEX_NONE; Granted = NextGrants[Granted])
+		{
+			const FTrafficReservationRequest& Other = Requests[Granted];
+			const float OtherPoint = Other.Distance + Graph.ConflictOtherDistances[Conflict];
+			const float OtherEnter = CalculateTravelTime(OtherPoint - HalfClearance, Other.Speed, Other.MaxSpeed);
+			const float OtherExit = CalculateTravelTime(OtherPoint + HalfClearance, Other.Speed, Other.MaxSpeed);
+			if (Enter < OtherExit && OtherEnter < Exit)
+				return true;
+		}
+	}
+
+	return false;
+}
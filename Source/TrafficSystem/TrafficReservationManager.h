@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FLaneGraph;
+
+// A vehicle asking to drive over a lane graph edge with conflicts, see FLaneGraph::ConflictEdges
+struct TRAFFICSYSTEM_API FTrafficReservationRequest
+{
+	int32 Handle = INDEX_NONE;
+
+	// Index of the vehicle in the state of the caller, not used by the manager
+	int32 Index = INDEX_NONE;
+
+	int32 Edge = INDEX_NONE;
+
+	// Distance to the start of the edge, negative once the vehicle is on it
+	float Distance = 0.0f;
+	float Speed = 0.0f;
+
+	// Speed on the edge the vehicle accelerates to
+	float MaxSpeed = 0.0f;
+
+	// Requests with a higher priority are served first, the earlier arrival among requests of the same priority
+	int32 Priority = 0;
+
+	// Vehicles on the edge or unable to stop in front of it are granted whatever the conflicts
+	bool bCommitted = false;
+
+	// Vehicles giving way to traffic with right of way are denied without a check, see EConnectionPriority
+	bool bYielding = false;
+
+	// Result of FTrafficReservationManager::Update
+	bool bGranted = false;
+};
+
+/**
+ * Time slots on the conflict points of intersections. Every step the vehicles approaching an edge with conflicts
+ * request it, and the manager grants the requests one after the other: committed vehicles first, then by priority
+ * and arrival time. A request is granted when the time the vehicle spends on each conflict point does not overlap
+ * the time of a granted vehicle on the other edge. Vehicles denied a slot stop in front of the edge and ask again
+ * the next step.
+ *
+ * Times are predicted from the distance, speed and a constant acceleration up to the speed on the edge and
+ * recalculated every step, so slots follow the vehicles. Only the edge held by every vehicle is kept between
+ * steps, it tells which vehicles are already on their edge.
+ */
+class TRAFFICSYSTEM_API FTrafficReservationManager
+{
+public:
+	void Reset(int32 NumEdges);
+
+	// Replaces the reservations of the last step with the granted requests, see FTrafficReservationRequest::bGranted
+	void Update(const FLaneGraph& Graph, TArrayView<FTrafficReservationRequest> Requests);
+
+	// Edge the vehicle holds a slot on, INDEX_NONE without one
+	int32 GetReservedEdge(int32 Handle) const;
+	void Release(int32 Handle);
+
+	// Handles granted a slot by the last update, including the ones released since
+	TArrayView<const int32> GetReservedHandles() const;
+
+	void Serialize(FArchive& Ar);
+
+	// Prediction of the time on the conflict points: acceleration of waiting vehicles in cm/s^2, length of the
+	// conflict point along the edge including the vehicle and the time kept free around it
+	float Acceleration = 200.0f;
+	float ClearanceDistance = 700.0f;
+	float TimeMargin = 0.5f;
+
+	// Lowest speed assumed for vehicles at the conflict points
+	float MinSpeed = 300.0f;
+
+protected:
+	// Seconds until a vehicle reaches Distance, accelerating from Speed to MaxSpeed
+	float CalculateTravelTime(float Distance, float Speed, float MaxSpeed) const;
+
+	bool HasConflict(const FLaneGraph& Graph, TArrayView<const FTrafficReservationRequest> Requests,
+					 const FTrafficReservationRequest& Request) const;
+
+	// Edge held by every handle and the handles holding one
+	TArray<int32> HandleEdges;
+	TArray<int32> ReservedHandles;
+
+	// Granted requests of the current update as lists per edge, cleared at the end of the update
+	TArray<int32> EdgeFirstGrants;
+	TArray<int32> NextGrants;
+	TArray<int32> GrantedEdges;
+
+	// Requests in the order they are served
+	TArray<int32> Order;
+	TArray<float> ArrivalTimes;
+};
@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficReservationPass.h"
+
+#include "Algo/Unique.h"
+#include "LaneGraph.h"
+#include "TrafficSerialization.h"
+#include "TrafficSignalTable.h"
+#include "TrafficSimulationCore.h"
+#include "TrafficVehicleState.h"
+
+void FTrafficReservationPass::Reset(const FLaneGraph& Graph)
+{
+	Reset();
+	Manager.Reset(Graph.OutTargets.Num());
+	for (int32 Node = 0; Node < Graph.GetNumNodes(); ++Node)
+	{
+		for (int32 Edge = Graph.OutOffsets[Node]; Edge < Graph.OutOffsets[Node + 1]; ++Edge)
+		{
+			if (Graph.GetNumConflicts(Edge) > 0 || Graph.OutPriorities[Edge] != EConnectionPriority::Normal)
+			{
+				RuleNodes.Add(Node);
+				break;
+			}
+		}
+	}
+}
+
+void FTrafficReservationPass::Reset()
+{
+	Manager.Reset(0);
+	RuleNodes.Reset();
+	Candidates.Reset();
+	Requests.Reset();
+	Stops.Reset();
+	StoppedHandles.Reset();
+}
+
+void FTrafficReservationPass::Update(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+									 const FTrafficSignalTable& Signals, const TArrayView<const int32> HandleToIndex,
+									 const TArrayView<const uint8> UpdateFlags, const float MaxElapsedTime,
+									 FTrafficVehicleState& State)
+{
+	// Vehicles not updated this step are in the occupancy where they were at their last update, up to the distance
+	// they drove since further back
+	Candidates.Reset();
+	const float SearchDistance = TrafficSimulation::ReservationDistance +
+		MaxElapsedTime * Graph.MaxTargetSpeed * TrafficSimulation::KilometersPerHourToCentimetersPerSecond;
+	for (const int32 Node : RuleNodes)
+	{
+		// Vehicles right at the node still ask for its edges
+		const float NodeDistance = Graph.NodeDistances[Node];
+		for (const FLaneOccupant& Occupant :
+			 Occupancy.GetOccupantsInRange(Graph.NodeLanes[Node], NodeDistance - SearchDistance, NodeDistance + 1.0f))
+		{
+			Candidates.Add(HandleToIndex[Occupant.Handle]);
+		}
+	}
+
+	// Vehicles holding a slot ask until they are through, the ones stopped may have moved on. Both lists can hold
+	// handles of removed vehicles.
+	const auto AddHandles = [this, HandleToIndex](const TArrayView<const int32> Handles)
+	{
+		for (const int32 Handle : Handles)
+		{
+			if (HandleToIndex.IsValidIndex(Handle) && HandleToIndex[Handle] != INDEX_NONE)
+				Candidates.Add(HandleToIndex[Handle]);
+		}
+	};
+	AddHandles(Manager.GetReservedHandles());
+	AddHandles(StoppedHandles);
+
+	// Requests are made in the order of the vehicles, kinematic vehicles are only moved after the reservations
+	Candidates.Sort();
+	Candidates.SetNum(Algo::Unique(Candidates), false);
+	Requests.Reset();
+	for (const int32 Index : Candidates)
+	{
+		if (Signals.IsNodeStop(State.TargetNodes[Index]))
+			continue;
+
+		const bool bUpdated = UpdateFlags.Num() == 0 || UpdateFlags[Index];
+		const float ElapsedTime = bUpdated && !State.KinematicFlags[Index] ? 0.0f : State.PendingDeltaTimes[Index];
+		TrafficSimulation::PickBranchAhead(Graph, Index, ElapsedTime, State);
+
+		FTrafficReservationRequest Request;
+		if (TrafficSimulation::RequestReservation(Graph, Occupancy, Manager, HandleToIndex, Index, ElapsedTime, State,
+												 Request))
+			Requests.Add(Request);
+	}
+
+	// Only candidates can have a stop flag set. Vehicles not updated this step are woken up when they have to stop
+	// or may go on, otherwise they would keep their inputs until their next update.
+	Manager.Update(Graph, Requests);
+	Stops.SetNumZeroed(State.Num());
+	StoppedHandles.Reset();
+	int32 RequestIndex = 0;
+	for (const int32 Index : Candidates)
+	{
+		uint8 bStop = 0;
+		if (Requests.IsValidIndex(RequestIndex) && Requests[RequestIndex].Index == Index)
+			bStop = Requests[RequestIndex++].bGranted ? 0 : 1;
+
+		if (bStop != Stops[Index] && UpdateFlags.Num() > 0 && !UpdateFlags[Index])
+			State.WakeFlags[Index] = 1;
+		Stops[Index] = bStop;
+		if (bStop)
+			StoppedHandles.Add(State.Handles[Index]);
+	}
+}
+
+bool FTrafficReservationPass::IsStop(const int32 Index) const
+{
+	return Stops.IsValidIndex(Index) && Stops[Index] != 0;
+}
+
+bool FTrafficReservationPass::HasReservation(const int32 Handle) const
+{
+	return Manager.GetReservedEdge(Handle) != INDEX_NONE;
+}
+
+int32 FTrafficReservationPass::GetNumRequests() const
+{
+	return Requests.Num();
+}
+
+void FTrafficReservationPass::RemoveVehicle(const FTrafficVehicleState& State, const int32 Index)
+{
+	// Vehicles added since the last update have no stop flag yet, stale stopped handles are skipped by the update
+	Manager.Release(State.Handles[Index]);
+	Stops.SetNumZeroed(State.Num());
+	Stops.RemoveAtSwap(Index, 1, false);
+}
+
+void FTrafficReservationPass::Serialize(FArchive& Ar)
+{
+	// The rule nodes come from the lane graph, candidates and requests only live during an update
+	Manager.Serialize(Ar);
+	TrafficSerialization::SerializeArray(Ar, Stops);
+	TrafficSerialization::SerializeArray(Ar, StoppedHandles);
+}
@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TrafficReservationManager.h"
+
+struct FLaneGraph;
+struct FTrafficVehicleState;
+class FLaneOccupancy;
+class FTrafficSignalTable;
+
+/**
+ * Reservation step shared by FTrafficSimulationCore and UTrafficSimulationSubsystem. The vehicles approaching an
+ * edge with conflicts or a stop ask for a slot, see TrafficSimulation::RequestReservation, and the ones denied
+ * one stop at their target until they are granted one. The stop flags are indexed like the vehicle state and kept
+ * between steps to tell which vehicles changed.
+ *
+ * Only the vehicles found in the occupancy within the reservation distance of a node with rules on its out edges
+ * ask, together with the ones holding a slot or stopped by the last step, so a step costs the traffic at
+ * intersections and not the number of vehicles.
+ */
+class TRAFFICSYSTEM_API FTrafficReservationPass
+{
+public:
+	void Reset(const FLaneGraph& Graph);
+	void Reset();
+
+	// Vehicles stopping at a signal leave the slots to the traffic let through. UpdateFlags marks the vehicles
+	// updated this step and is empty when all of them are. The state of the others is up to MaxElapsedTime old,
+	// they ask from where they are expected to be by now and are woken up when they have to stop or may go on.
+	void Update(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy, const FTrafficSignalTable& Signals,
+				TArrayView<const int32> HandleToIndex, TArrayView<const uint8> UpdateFlags, float MaxElapsedTime,
+				FTrafficVehicleState& State);
+
+	bool IsStop(int32 Index) const;
+	bool HasReservation(int32 Handle) const;
+
+	// Requests of the last update
+	int32 GetNumRequests() const;
+
+	// Releases the slot of the vehicle at Index, called before it is removed from State by swap
+	void RemoveVehicle(const FTrafficVehicleState& State, int32 Index);
+
+	void Serialize(FArchive& Ar);
+
+	FTrafficReservationManager Manager;
+
+protected:
+	// Nodes with conflicts or right of way rules on one of their out edges
+	TArray<int32> RuleNodes;
+
+	// Vehicles asking this step by index, in order, and their requests
+	TArray<int32> Candidates;
+	TArray<FTrafficReservationRequest> Requests;
+
+	// Stop flag of every vehicle and the handles of the vehicles with one set
+	TArray<uint8> Stops;
+	TArray<int32> StoppedHandles;
+};
@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/Archive.h"
+
+namespace TrafficSerialization
+{
+	// Copies the array as raw memory. Only for trivially copyable elements and for archives read back by the same
+	// build on the same platform, like simulation snapshots.
+	template <typename ElementType>
+	void SerializeArray(FArchive& Ar, TArray<ElementType>& Array)
+	{
+		static_assert(TIsTriviallyCopyConstructible<ElementType>::Value, "Elements are copied as raw memory");
+
+		int32 Num = Array.Num();
+		Ar << Num;
+		if (Ar.IsLoading())
+		{
+			if (Num < 0 || Num * static_cast<int64>(sizeof(ElementType)) > Ar.TotalSize() - Ar.Tell())
+			{
+				Ar.SetError();
+				return;
+			}
+			Array.SetNumUninitialized(Num);
+		}
+
+		Ar.Serialize(Array.GetData(), Num * sizeof(ElementType));
+	}
+}
@@ -0,0 +1,224 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficSignalScheduler.h"
+
+#include "TrafficSerialization.h"
+
+namespace
+{
+	// Keeps plans with zero durations from switching forever within one update
+	constexpr float MinPhaseDuration = 0.1f;
+}
+
+float FTrafficSignalMetrics::GetThroughputPerHour(const double Time) const
+{
+	const double Duration = Time - StartTime;
+	return Duration > 0.0 ? static_cast<float>(NumPassedVehicles * 3600.0 / Duration) : 0.0f;
+}
+
+float FTrafficSignalMetrics::GetAverageDelaySeconds() const
+{
+	return NumPassedVehicles > 0 ? static_cast<float>(TotalDelaySeconds / NumPassedVehicles) : 0.0f;
+}
+
+int32 FTrafficSignalScheduler::AddPlan(const TArrayView<const FTrafficSignalPhase> Phases, const double StartTime,
+									   const FTrafficSignalAdaptiveTiming* AdaptiveTiming)
+{
+	if (Phases.Num() == 0)
+		return INDEX_NONE;
+
+	const int32 Plan = PlanFirstPhases.Add(PhaseGoDurations.Num());
+	PlanNumPhases.Add(Phases.Num());
+	PlanCurrentPhases.Add(Phases.Num() - 1);
+	PlanGoFlags.Add(0);
+	PlanAdaptiveFlags.Add(AdaptiveTiming ? 1 : 0);
+	PlanGoStartTimes.Add(StartTime);
+
+	FTrafficSignalAdaptiveTiming& Timing =
+		PlanAdaptiveTimings.Add_GetRef(AdaptiveTiming ? *AdaptiveTiming : FTrafficSignalAdaptiveTiming());
+	Timing.MinGoDuration = FMath::Max(Timing.MinGoDuration, MinPhaseDuration);
+	Timing.ExtensionInterval = FMath::Max(Timing.ExtensionInterval, MinPhaseDuration);
+	NumAdaptivePlans += AdaptiveTiming ? 1 : 0;
+
+	for (const FTrafficSignalPhase& Phase : Phases)
+	{
+		PhaseSignals.Append(Phase.Signals);
+		PhaseSignalOffsets.Add(PhaseSignals.Num());
+		PhaseGoDurations.Add(FMath::Max(Phase.GoDuration, MinPhaseDuration));
+		PhaseWaitDurations.Add(FMath::Max(Phase.WaitDuration, MinPhaseDuration));
+	}
+
+	// The plan starts as if the wait after its last phase just expired
+	Events.HeapPush({ StartTime, Plan });
+	return Plan;
+}
+
+void FTrafficSignalScheduler::Advance(const double InTime, const TArrayView<const float> SignalPressures,
+									  TArray<FTrafficSignalChange>& OutChanges)
+{
+	while (Events.Num() > 0 && Events.HeapTop().Time <= InTime)
+	{
+		FEvent Event;
+		Events.HeapPop(Event, false);
+
+		const int32 Plan = Event.Plan;
+		const bool bAdaptive = PlanAdaptiveFlags[Plan] != 0;
+		int32& CurrentPhase = PlanCurrentPhases[Plan];
+		double NextTime;
+		if (PlanGoFlags[Plan])
+		{
+			if (bAdaptive && ShouldExtendGo(Plan, Event.Time, SignalPressures))
+			{
+				Events.HeapPush({ Event.Time + PlanAdaptiveTimings[Plan].ExtensionInterval, Plan });
+				continue;
+			}
+
+			AddPhaseChanges(PlanFirstPhases[Plan] + CurrentPhase, true, OutChanges);
+			NextTime = Event.Time + PhaseWaitDurations[PlanFirstPhases[Plan] + CurrentPhase];
+			PlanGoFlags[Plan] = 0;
+		}
+		else
+		{
+			CurrentPhase =
+				bAdaptive ? SelectNextPhase(Plan, SignalPressures) : (CurrentPhase + 1) % PlanNumPhases[Plan];
+			AddPhaseChanges(PlanFirstPhases[Plan] + CurrentPhase, false, OutChanges);
+
+			// Adaptive plans check for an extension after the minimum go, the phase duration is the maximum
+			const float GoDuration = PhaseGoDurations[PlanFirstPhases[Plan] + CurrentPhase];
+			NextTime = Event.Time + (bAdaptive ? FMath::Min(PlanAdaptiveTimings[Plan].MinGoDuration, GoDuration)
+											   : GoDuration);
+			PlanGoFlags[Plan] = 1;
+			PlanGoStartTimes[Plan] = Event.Time;
+		}
+
+		Events.HeapPush({ NextTime, Plan });
+	}
+
+	Time = FMath::Max(Time, InTime);
+}
+
+bool FTrafficSignalScheduler::HasAdaptivePlans() const
+{
+	return NumAdaptivePlans > 0;
+}
+
+void FTrafficSignalScheduler::Reset()
+{
+	PlanFirstPhases.Reset();
+	PlanNumPhases.Reset();
+	PlanCurrentPhases.Reset();
+	PlanGoFlags.Reset();
+	PlanAdaptiveFlags.Reset();
+	PlanAdaptiveTimings.Reset();
+	PlanGoStartTimes.Reset();
+	NumAdaptivePlans = 0;
+	PhaseSignalOffsets.Reset();
+	PhaseSignalOffsets.Add(0);
+	PhaseSignals.Reset();
+	PhaseGoDurations.Reset();
+	PhaseWaitDurations.Reset();
+	Events.Reset();
+	Time = 0.0;
+}
+
+double FTrafficSignalScheduler::GetTime() const
+{
+	return Time;
+}
+
+int32 FTrafficSignalScheduler::GetNumPlans() const
+{
+	return PlanFirstPhases.Num();
+}
+
+int32 FTrafficSignalScheduler::GetCurrentPhase(const int32 Plan) const
+{
+	return PlanCurrentPhases[Plan];
+}
+
+bool FTrafficSignalScheduler::IsPlanGo(const int32 Plan) const
+{
+	return PlanGoFlags[Plan] != 0;
+}
+
+void FTrafficSignalScheduler::Serialize(FArchive& Ar)
+{
+	TrafficSerialization::SerializeArray(Ar, PlanFirstPhases);
+	TrafficSerialization::SerializeArray(Ar, PlanNumPhases);
+	TrafficSerialization::SerializeArray(Ar, PlanCurrentPhases);
+	TrafficSerialization::SerializeArray(Ar, PlanGoFlags);
+	TrafficSerialization::SerializeArray(Ar, PlanAdaptiveFlags);
+	TrafficSerialization::SerializeArray(Ar, PlanAdaptiveTimings);
+	TrafficSerialization::SerializeArray(Ar, PlanGoStartTimes);
+	Ar << NumAdaptivePlans;
+	TrafficSerialization::SerializeArray(Ar, PhaseSignalOffsets);
+	TrafficSerialization::SerializeArray(Ar, PhaseSignals);
+	TrafficSerialization::SerializeArray(Ar, PhaseGoDurations);
+	TrafficSerialization::SerializeArray(Ar, PhaseWaitDurations);
+	TrafficSerialization::SerializeArray(Ar, Events);
+	Ar << Time;
+}
+
+void FTrafficSignalScheduler::AddPhaseChanges(const int32 Phase, const bool bStop,
+											  TArray<FTrafficSignalChange>& OutChanges) const
+{
+	for (int32 Signal = PhaseSignalOffsets[Phase]; Signal < PhaseSignalOffsets[Phase + 1]; ++Signal)
+	{
+		OutChanges.Add({ PhaseSignals[Signal], bStop });
+	}
+}
+
+int32 FTrafficSignalScheduler::SelectNextPhase(const int32 Plan, const TArrayView<const float> SignalPressures) const
+{
+	// Highest pressure wins, ties and a network without queues keep the cyclic order
+	const int32 NumPhases = PlanNumPhases[Plan];
+	int32 BestPhase = (PlanCurrentPhases[Plan] + 1) % NumPhases;
+	float BestPressure = CalculatePressure(PlanFirstPhases[Plan] + BestPhase, SignalPressures);
+	for (int32 Step = 2; Step <= NumPhases; ++Step)
+	{
+		const int32 Phase = (PlanCurrentPhases[Plan] + Step) % NumPhases;
+		const float Pressure = CalculatePressure(PlanFirstPhases[Plan] + Phase, SignalPressures);
+		if (Pressure > BestPressure)
+		{
+			BestPhase = Phase;
+			BestPressure = Pressure;
+		}
+	}
+
+	return BestPhase;
+}
+
+bool FTrafficSignalScheduler::ShouldExtendGo(const int32 Plan, const double InTime,
+											 const TArrayView<const float> SignalPressures) const
+{
+	const int32 CurrentPhase = PlanFirstPhases[Plan] + PlanCurrentPhases[Plan];
+	const double GoEndTime = PlanGoStartTimes[Plan] + PhaseGoDurations[CurrentPhase];
+	if (InTime + PlanAdaptiveTimings[Plan].ExtensionInterval > GoEndTime)
+		return false;
+
+	// Gap out once the queue is served, yield once another phase has more pressure
+	const float CurrentPressure = CalculatePressure(CurrentPhase, SignalPressures);
+	if (CurrentPressure <= 0.0f)
+		return false;
+
+	for (int32 Phase = PlanFirstPhases[Plan]; Phase < PlanFirstPhases[Plan] + PlanNumPhases[Plan]; ++Phase)
+	{
+		if (Phase != CurrentPhase && CalculatePressure(Phase, SignalPressures) > CurrentPressure)
+			return false;
+	}
+
+	return true;
+}
+
+float FTrafficSignalScheduler::CalculatePressure(const int32 Phase, const TArrayView<const float> SignalPressures) const
+{
+	float Pressure = 0.0f;
+	for (int32 Signal = PhaseSignalOffsets[Phase]; Signal < PhaseSignalOffsets[Phase + 1]; ++Signal)
+	{
+		if (SignalPressures.IsValidIndex(PhaseSignals[Signal]))
+			Pressure += SignalPressures[PhaseSignals[Signal]];
+	}
+
+	return Pressure;
+}
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct TRAFFICSYSTEM_API FTrafficSignalPhase
+{
+	// Signals switched to go while the phase is active
+	TArray<int32> Signals;
+
+	float GoDuration = 10.0f;
+
+	// Time all signals of the plan stop after the phase before the next one starts
+	float WaitDuration = 3.0f;
+};
+
+// Max-pressure timing of a plan. After every wait the phase with the highest pressure goes, its go is extended
+// in steps while it still has the highest pressure and vehicles queue, up to the GoDuration of the phase.
+struct TRAFFICSYSTEM_API FTrafficSignalAdaptiveTiming
+{
+	float MinGoDuration = 5.0f;
+	float ExtensionInterval = 1.0f;
+};
+
+struct TRAFFICSYSTEM_API FTrafficSignalChange
+{
+	int32 Signal = INDEX_NONE;
+	bool bStop = true;
+};
+
+// Vehicles that passed a signal and the time they were held up in front of it
+struct TRAFFICSYSTEM_API FTrafficSignalMetrics
+{
+	int64 NumPassedVehicles = 0;
+	double TotalDelaySeconds = 0.0;
+	double StartTime = 0.0;
+
+	float GetThroughputPerHour(double Time) const;
+	float GetAverageDelaySeconds() const;
+};
+
+/**
+ * Cycles the phase plans of all traffic light controllers. Plans are stored in flat arrays and their next
+ * phase changes are kept in one event queue sorted by time, so an update only touches the plans with a
+ * change due. Changes happen at the exact time of the plan, not at the time of the update, which makes the
+ * result independent of the frame rate: advancing once by a minute gives the same signal states as advancing
+ * frame by frame, which is used to fast-forward replays.
+ *
+ * Adaptive plans decide at their changes using the pressure of every signal, the queue in front of it minus the
+ * queue behind it. Pressures are only sampled once per update, so they are identical for all changes of a plan
+ * within one fast-forward.
+ */
+class TRAFFICSYSTEM_API FTrafficSignalScheduler
+{
+public:
+	// Starts the plan at StartTime, all signals of the plan are expected to stop before. Fixed plans start with
+	// their first phase and cycle through all phases. Returns INDEX_NONE for plans without phases.
+	int32 AddPlan(TArrayView<const FTrafficSignalPhase> Phases, double StartTime,
+				  const FTrafficSignalAdaptiveTiming* AdaptiveTiming = nullptr);
+
+	// Appends all changes due up to Time in the order they happen. SignalPressures is indexed by signal and only
+	// read by adaptive plans, missing signals have no pressure.
+	void Advance(double Time, TArrayView<const float> SignalPressures, TArray<FTrafficSignalChange>& OutChanges);
+
+	bool HasAdaptivePlans() const;
+
+	void Reset();
+
+	double GetTime() const;
+	int32 GetNumPlans() const;
+
+	// Phase the plan is in and whether its signals are at go, false during the wait after a phase
+	int32 GetCurrentPhase(int32 Plan) const;
+	bool IsPlanGo(int32 Plan) const;
+
+	// Writes or reads all plans with their pending changes, see FTrafficSimulationCore::SaveSnapshot
+	void Serialize(FArchive& Ar);
+
+protected:
+	struct FEvent
+	{
+		double Time;
+		int32 Plan;
+
+		// Equal times are ordered by plan so the result does not depend on the order of insertion
+		bool operator<(const FEvent& Other) const
+		{
+			return Time < Other.Time || (Time == Other.Time && Plan < Other.Plan);
+		}
+	};
+
+	void AddPhaseChanges(int32 Phase, bool bStop, TArray<FTrafficSignalChange>& OutChanges) const;
+
+	// Adaptive plans: the phase going after a wait and whether the current go is extended at Time
+	int32 SelectNextPhase(int32 Plan, TArrayView<const float> SignalPressures) const;
+	bool ShouldExtendGo(int32 Plan, double Time, TArrayView<const float> SignalPressures) const;
+	float CalculatePressure(int32 Phase, TArrayView<const float> SignalPressures) const;
+
+	// Plans
+	TArray<int32> PlanFirstPhases;
+	TArray<int32> PlanNumPhases;
+	TArray<int32> PlanCurrentPhases;
+	TArray<uint8> PlanGoFlags;
+	TArray<uint8> PlanAdaptiveFlags;
+	TArray<FTrafficSignalAdaptiveTiming> PlanAdaptiveTimings;
+	TArray<double> PlanGoStartTimes;
+	int32 NumAdaptivePlans = 0;
+
+	// Phases of all plans, the signals of a phase are at PhaseSignalOffsets[Phase] to [Phase + 1]
+	TArray<int32> PhaseSignalOffsets = { 0 };
+	TArray<int32> PhaseSignals;
+	TArray<float> PhaseGoDurations;
+	TArray<float> PhaseWaitDurations;
+
+	// Next change of every plan as a min heap
+	TArray<FEvent> Events;
+	double Time = 0.0;
+};
@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficSignalTable.h"
+
+#include "LaneGraph.h"
+#include "LaneOccupancy.h"
+#include "TrafficSerialization.h"
+
+void FTrafficSignalTable::Reset(const FLaneGraph& Graph)
+{
+	Reset();
+	NodeStops = Graph.StopFlags;
+	NodeSignals.Init(INDEX_NONE, Graph.GetNumNodes());
+}
+
+void FTrafficSignalTable::Reset()
+{
+	NodeStops.Reset();
+	NodeSignals.Reset();
+	SignalStops.Reset();
+	SignalNodeOffsets.Reset();
+	SignalNodeOffsets.Add(0);
+	SignalNodes.Reset();
+	SignalPressures.Reset();
+}
+
+int32 FTrafficSignalTable::AddSignal(const TArrayView<const int32> Nodes, const bool bStopFlag)
+{
+	const int32 Signal = SignalStops.Add(bStopFlag ? 1 : 0);
+	for (const int32 Node : Nodes)
+	{
+		if (!NodeSignals.IsValidIndex(Node))
+			continue;
+
+		// A node belongs to one signal, the last one added wins
+		if (NodeSignals[Node] != INDEX_NONE)
+			UE_LOG(LogTemp, Warning, TEXT("Lane graph node %d is governed by more than one signal"), Node);
+
+		NodeSignals[Node] = Signal;
+		NodeStops[Node] = 0;
+		SignalNodes.Add(Node);
+	}
+	SignalNodeOffsets.Add(SignalNodes.Num());
+
+	return Signal;
+}
+
+bool FTrafficSignalTable::SetSignalStop(const int32 Signal, const bool bStopFlag)
+{
+	if (!SignalStops.IsValidIndex(Signal) || (SignalStops[Signal] != 0) == bStopFlag)
+		return false;
+
+	SignalStops[Signal] = bStopFlag ? 1 : 0;
+	return true;
+}
+
+bool FTrafficSignalTable::IsSignalStop(const int32 Signal) const
+{
+	return SignalStops.IsValidIndex(Signal) && SignalStops[Signal] != 0;
+}
+
+int32 FTrafficSignalTable::GetNumSignals() const
+{
+	return SignalStops.Num();
+}
+
+TArrayView<const int32> FTrafficSignalTable::GetSignalNodes(const int32 Signal) const
+{
+	return TArrayView<const int32>(SignalNodes.GetData() + SignalNodeOffsets[Signal],
+								   SignalNodeOffsets[Signal + 1] - SignalNodeOffsets[Signal]);
+}
+
+void FTrafficSignalTable::SetNodeStop(const int32 Node, const bool bStopFlag)
+{
+	if (NodeStops.IsValidIndex(Node))
+		NodeStops[Node] = bStopFlag ? 1 : 0;
+}
+
+bool FTrafficSignalTable::IsNodeStop(const int32 Node) const
+{
+	if (!NodeStops.IsValidIndex(Node))
+		return false;
+
+	const int32 Signal = NodeSignals[Node];
+	return NodeStops[Node] != 0 || (Signal != INDEX_NONE && SignalStops[Signal] != 0);
+}
+
+int32 FTrafficSignalTable::GetNodeSignal(const int32 Node) const
+{
+	return NodeSignals.IsValidIndex(Node) ? NodeSignals[Node] : INDEX_NONE;
+}
+
+void FTrafficSignalTable::UpdatePressures(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+										  const float QueueDistance)
+{
+	SignalPressures.SetNumUninitialized(SignalStops.Num(), false);
+	for (int32 Signal = 0; Signal < SignalStops.Num(); ++Signal)
+	{
+		SignalPressures[Signal] = CalculatePressure(Graph, Occupancy, Signal, QueueDistance);
+	}
+}
+
+TArrayView<const float> FTrafficSignalTable::GetPressures() const
+{
+	return SignalPressures;
+}
+
+void FTrafficSignalTable::Serialize(FArchive& Ar)
+{
+	TrafficSerialization::SerializeArray(Ar, NodeStops);
+	TrafficSerialization::SerializeArray(Ar, NodeSignals);
+	TrafficSerialization::SerializeArray(Ar, SignalStops);
+	TrafficSerialization::SerializeArray(Ar, SignalNodeOffsets);
+	TrafficSerialization::SerializeArray(Ar, SignalNodes);
+	TrafficSerialization::SerializeArray(Ar, SignalPressures);
+}
+
+float FTrafficSignalTable::CalculatePressure(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+											 const int32 Signal, const float QueueDistance) const
+{
+	float Pressure = 0.0f;
+	for (const int32 Node : GetSignalNodes(Signal))
+	{
+		const float StopDistance = Graph.NodeDistances[Node];
+		Pressure += Occupancy.CountInRange(Graph.NodeLanes[Node], StopDistance - QueueDistance, StopDistance);
+
+		// Vehicles behind the stop line block the vehicles let through, averaged over the branches
+		const TArrayView<const int32> OutEdges = Graph.GetOutEdges(Node);
+		for (const int32 Next : OutEdges)
+		{
+			const float EntryDistance =
+				Graph.NodeDistances[Next] - FVector::Dist2D(Graph.Positions[Node], Graph.Positions[Next]);
+			Pressure -= static_cast<float>(Occupancy.CountInRange(Graph.NodeLanes[Next], EntryDistance,
+																   EntryDistance + QueueDistance)) /
+				OutEdges.Num();
+		}
+	}
+
+	return Pressure;
+}
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FLaneGraph;
+class FLaneOccupancy;
+
+/**
+ * Runtime stop state of the lane graph nodes, shared by FTrafficSimulationCore and UTrafficSimulationSubsystem.
+ * A node stops by its own flag, initialized from FWaypoint::Stop, or while the signal governing it does. Signals
+ * store the stop state of a traffic light once for all nodes it governs, so switching one is a single write.
+ */
+class TRAFFICSYSTEM_API FTrafficSignalTable
+{
+public:
+	void Reset(const FLaneGraph& Graph);
+	void Reset();
+
+	// Nodes governed by a signal stop with it from now on, their own flag is cleared
+	int32 AddSignal(TArrayView<const int32> Nodes, bool bStopFlag);
+
+	// False if the signal already was in that state
+	bool SetSignalStop(int32 Signal, bool bStopFlag);
+	bool IsSignalStop(int32 Signal) const;
+	int32 GetNumSignals() const;
+	TArrayView<const int32> GetSignalNodes(int32 Signal) const;
+
+	void SetNodeStop(int32 Node, bool bStopFlag);
+	bool IsNodeStop(int32 Node) const;
+
+	// Signal governing the node, INDEX_NONE without one
+	int32 GetNodeSignal(int32 Node) const;
+
+	// Queue in front of every signal minus the queue behind it, the input of adaptive signal timing
+	void UpdatePressures(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy, float QueueDistance);
+	TArrayView<const float> GetPressures() const;
+
+	void Serialize(FArchive& Ar);
+
+protected:
+	float CalculatePressure(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy, int32 Signal,
+							float QueueDistance) const;
+
+	// Per node
+	TArray<uint8> NodeStops;
+	TArray<int32> NodeSignals;
+
+	// Per signal, the nodes of a signal are at SignalNodeOffsets[Signal] to [Signal + 1]
+	TArray<uint8> SignalStops;
+	TArray<int32> SignalNodeOffsets;
+	TArray<int32> SignalNodes;
+	TArray<float> SignalPressures;
+};
@@ -0,0 +1,794 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficSimulationCore.h"
+
+#include "Async/ParallelFor.h"
+#include "LaneGraph.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "TrafficSerialization.h"
+
+namespace
+{
+	// Limits of the search for the vehicle ahead beyond the own lane
+	constexpr float LeaderSearchDistance = 5000.0f;
+	constexpr int32 LeaderSearchMaxNodes = 32;
+
+	// Waypoints and spline shape points a vehicle may pass in one step
+	constexpr int32 MaxStepsPerMove = 16;
+
+	// Vehicles asking for a slot are committed to it once they cannot stop in front of the edge braking this hard
+	constexpr float ReservationBrakingDeceleration = 500.0f;
+
+	// Gap acceptance at yield and stop connections: time to the next vehicle with right of way needed to go, how
+	// far back these vehicles are looked for and what counts as standing at the stop line
+	constexpr float YieldCriticalGap = 4.0f;
+	constexpr float StopCriticalGap = 5.0f;
+	constexpr float PriorityGapDistance = 8000.0f;
+	constexpr float MinPriorityGapSpeed = 100.0f;
+	constexpr float StoppedSpeed = 50.0f;
+	constexpr float StopLineDistance = 600.0f;
+
+	// Header of snapshots, the version changes with the layout of the state
+	constexpr uint32 SnapshotMagic = 0x54524653;
+	constexpr uint32 SnapshotVersion = 8;
+
+	// Reservations serve higher ranks first, yield and stop connections give way to higher ranks
+	int32 GetPriorityRank(const EConnectionPriority Priority)
+	{
+		switch (Priority)
+		{
+		case EConnectionPriority::PriorityRoad:
+			return 2;
+		case EConnectionPriority::Normal:
+			return 1;
+		default:
+			return 0;
+		}
+	}
+
+	float CalculateEdgeSpeed(const FLaneGraph& Graph, const int32 Edge)
+	{
+		return FMath::Min(Graph.TargetSpeeds[Graph.OutTargets[Edge]] *
+							  TrafficSimulation::KilometersPerHourToCentimetersPerSecond,
+						  Graph.OutSpeedLimits[Edge]);
+	}
+
+	// Distance along the lane of its target where the edge starts: the source node along a lane, one straight edge
+	// length before the target on connections from other lanes, like CalculateLaneDistance
+	float CalculateEdgeStart(const FLaneGraph& Graph, const int32 Edge)
+	{
+		const int32 FromNode = Graph.OutSources[Edge];
+		const int32 ToNode = Graph.OutTargets[Edge];
+		if (ToNode == FromNode + 1 && Graph.NodeLanes[FromNode] == Graph.NodeLanes[ToNode])
+			return Graph.NodeDistances[FromNode];
+
+		return Graph.NodeDistances[ToNode] - FVector::Dist2D(Graph.Positions[FromNode], Graph.Positions[ToNode]);
+	}
+}
+
+void TrafficSimulation::FindLeader(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+								   const FTrafficVehicleState& State, const int32 Index, int32& OutLeader, float& OutGap)
+{
+	OutLeader = INDEX_NONE;
+	OutGap = MAX_FLT;
+
+	const int32 Handle = State.Handles[Index];
+	FLaneOccupant Occupant;
+	if (Occupancy.GetNextOnLane(Handle, Occupant))
+	{
+		OutLeader = Occupant.Handle;
+		OutGap = Occupant.Distance - State.LaneDistances[Index];
+		return;
+	}
+
+	int32 Node = State.TargetNodes[Index];
+	if (Node == INDEX_NONE)
+		return;
+
+	// Nobody ahead on the own lane, follow the route or the lane into the next lanes
+	const TArray<int32>& Route = State.Routes[Index];
+	int32 RouteCursor = State.RouteCursors[Index];
+	float Distance = Graph.NodeDistances[Node] - State.LaneDistances[Index];
+
+	for (int32 Step = 0; Step < LeaderSearchMaxNodes && Distance < LeaderSearchDistance; ++Step)
+	{
+		const bool bFollowRoute = Route.IsValidIndex(RouteCursor + 1);
+		const TArrayView<const int32> OutEdges =
+			bFollowRoute ? MakeArrayView(&Route[RouteCursor + 1], 1) : Graph.GetOutEdges(Node);
+		++RouteCursor;
+
+		// Without a route the branch is not known yet, take the closest vehicle behind any of them
+		for (const int32 Next : OutEdges)
+		{
+			const int32 NextLane = Graph.NodeLanes[Next];
+			if (NextLane == Graph.NodeLanes[Node])
+				continue;
+
+			const float EdgeLength = FVector::Dist2D(Graph.Positions[Node], Graph.Positions[Next]);
+			const float EntryDistance = Graph.NodeDistances[Next];
+			if (Occupancy.FindFirstFrom(NextLane, EntryDistance - EdgeLength, Occupant) && Occupant.Handle != Handle)
+			{
+				const float Gap = Distance + EdgeLength + Occupant.Distance - EntryDistance;
+				if (Gap < OutGap)
+				{
+					OutLeader = Occupant.Handle;
+					OutGap = Gap;
+				}
+			}
+		}
+
+		if (OutLeader != INDEX_NONE || OutEdges.Num() != 1)
+			return;
+
+		const int32 Next = OutEdges[0];
+		Distance += FVector::Dist2D(Graph.Positions[Node], Graph.Positions[Next]);
+		Node = Next;
+	}
+}
+
+void TrafficSimulation::UpdateFollowing(const FLaneGraph& Graph, const TArrayView<const int32> HandleToIndex,
+										const bool bStopAtTarget, const int32 Index, FTrafficVehicleState& State)
+{
+	const float Speed = State.Speeds[Index];
+	const int32 TargetNode = State.TargetNodes[Index];
+	if (TargetNode == INDEX_NONE)
+	{
+		// A stop right in front makes the model brake fully, the desired speed alone would creep and brake in turns
+		State.DesiredSpeeds[Index] = 0.0f;
+		State.Gaps[Index] = 0.0f;
+		State.ApproachingRates[Index] = Speed;
+		return;
+	}
+
+	// Follow the closer of the vehicle ahead and a stop at the target
+	float Gap = MAX_FLT;
+	float ApproachingRate = 0.0f;
+	const int32 Leader = State.Leaders[Index];
+	if (Leader != INDEX_NONE)
+	{
+		Gap = State.LeaderGaps[Index] - VehicleLength;
+		ApproachingRate = Speed - State.Speeds[HandleToIndex[Leader]];
+	}
+
+	if (bStopAtTarget)
+	{
+		const float StopGap = Graph.NodeDistances[TargetNode] - State.LaneDistances[Index] - 0.5f * VehicleLength;
+		if (StopGap < Gap)
+		{
+			Gap = StopGap;
+			ApproachingRate = Speed;
+		}
+	}
+
+	// The speed profile of the lane slows down ahead of curves and slower waypoints
+	const float SpeedLimit = Graph.CalculateSpeedLimit(Graph.NodeLanes[TargetNode], State.LaneDistances[Index]);
+	State.DesiredSpeeds[Index] =
+		FMath::Min(Graph.TargetSpeeds[TargetNode] * KilometersPerHourToCentimetersPerSecond, SpeedLimit);
+	State.Gaps[Index] = Gap;
+	State.ApproachingRates[Index] = ApproachingRate;
+}
+
+void TrafficSimulation::SelectNextTarget(const FLaneGraph& Graph, const int32 Index, FTrafficVehicleState& State)
+{
+	int32& TargetNode = State.TargetNodes[Index];
+	State.PreviousNodes[Index] = TargetNode;
+	TArray<int32>& Route = State.Routes[Index];
+	int32& RouteCursor = State.RouteCursors[Index];
+	if (Route.IsValidIndex(RouteCursor + 1))
+	{
+		TargetNode = Route[++RouteCursor];
+		return;
+	}
+
+	// Without a route pick a random branch, sinks leave the vehicle without a target
+	Route.Reset();
+	RouteCursor = 0;
+
+	const int32 NumOutEdges = Graph.GetNumOutEdges(TargetNode);
+	if (NumOutEdges > 0)
+	{
+		TargetNode = Graph.GetOutEdge(TargetNode, State.RandomStreams[Index].RandHelper(NumOutEdges));
+	}
+	else
+	{
+		TargetNode = INDEX_NONE;
+	}
+}
+
+void TrafficSimulation::MoveAlongGraph(const FLaneGraph& Graph, const int32 Index, float Distance,
+									   FTrafficVehicleState& State)
+{
+	FVector Location = State.Locations[Index];
+	for (int32 Step = 0; Step < MaxStepsPerMove && State.TargetNodes[Index] != INDEX_NONE; ++Step)
+	{
+		// Spline segments are followed through their shape points on the way to the node
+		const int32 TargetNode = State.TargetNodes[Index];
+		const int32 ShapePoint = Graph.FindNextShapePoint(State.PreviousNodes[Index], TargetNode, Location);
+		const FVector& TargetLocation = Graph.ShapePositions[ShapePoint];
+		const FVector ToTarget = TargetLocation - Location;
+		const float DistanceToTarget = ToTarget.Size();
+		if (DistanceToTarget > KINDA_SMALL_NUMBER)
+			State.Forwards[Index] = ToTarget / DistanceToTarget;
+
+		if (Distance < DistanceToTarget)
+		{
+			Location += State.Forwards[Index] * Distance;
+			break;
+		}
+
+		Location = TargetLocation;
+		Distance -= DistanceToTarget;
+		if (ShapePoint == Graph.NodeShapePoints[TargetNode])
+			SelectNextTarget(Graph, Index, State);
+	}
+
+	State.Locations[Index] = Location;
+}
+
+FVector TrafficSimulation::CalculateLookaheadPoint(const FLaneGraph& Graph, const FTrafficVehicleState& State,
+												  const int32 Index, const float Lookahead)
+{
+	const int32 TargetNode = State.TargetNodes[Index];
+	const int32 Lane = Graph.NodeLanes[TargetNode];
+	const int32 LastNode = Graph.LaneFirstNodes[Lane] + Graph.LaneNumNodes[Lane] - 1;
+	const float Distance = State.LaneDistances[Index] + Lookahead;
+	if (Distance <= Graph.NodeDistances[LastNode])
+		return Graph.CalculateLanePoint(Lane, Distance);
+
+	// The next lane is the one of the route after the lane end, or the only way on
+	int32 NextNode = INDEX_NONE;
+	const TArray<int32>& Route = State.Routes[Index];
+	for (int32 Cursor = State.RouteCursors[Index]; Cursor + 1 < Route.Num(); ++Cursor)
+	{
+		if (Route[Cursor] == LastNode)
+		{
+			NextNode = Route[Cursor + 1];
+			break;
+		}
+
+		if (Graph.NodeLanes[Route[Cursor]] != Lane)
+			break;
+	}
+
+	if (NextNode == INDEX_NONE && Graph.GetNumOutEdges(LastNode) == 1)
+		NextNode = Graph.GetOutEdge(LastNode, 0);
+
+	if (NextNode == INDEX_NONE)
+		return Graph.Positions[LastNode];
+
+	const float Remaining = Distance - Graph.NodeDistances[LastNode];
+	const float EdgeLength = FVector::Dist2D(Graph.Positions[LastNode], Graph.Positions[NextNode]);
+	if (Remaining < EdgeLength)
+		return FMath::Lerp(Graph.Positions[LastNode], Graph.Positions[NextNode], Remaining / EdgeLength);
+
+	return Graph.CalculateLanePoint(Graph.NodeLanes[NextNode], Graph.NodeDistances[NextNode] + Remaining - EdgeLength);
+}
+
+float TrafficSimulation::CalculateLaneDistance(const FLaneGraph& Graph, const FTrafficVehicleState& State,
+											   const int32 Index)
+{
+	// Vehicles belong to the lane of their target and are placed short of it by their remaining distance,
+	// connections from other lanes are straight lines to the target
+	const int32 TargetNode = State.TargetNodes[Index];
+	const int32 PreviousNode = State.PreviousNodes[Index];
+	const FVector& Location = State.Locations[Index];
+	if (PreviousNode != TargetNode - 1 || TargetNode == Graph.LaneFirstNodes[Graph.NodeLanes[TargetNode]])
+		return Graph.NodeDistances[TargetNode] - FVector::Dist2D(Location, Graph.Positions[TargetNode]);
+
+	// Along the lane the vehicle is projected onto the shape segment it drives on, which keeps the distance on
+	// the arc length of spline lanes
+	const int32 Point = Graph.FindNextShapePoint(PreviousNode, TargetNode, Location);
+	const FVector& SegmentStart = Graph.ShapePositions[Point - 1];
+	const FVector Direction = (Graph.ShapePositions[Point] - SegmentStart).GetSafeNormal2D();
+	const float SegmentLength = Graph.ShapeDistances[Point] - Graph.ShapeDistances[Point - 1];
+	const float Along = FVector::DotProduct(Location - SegmentStart, Direction);
+	return Graph.ShapeDistances[Point - 1] + FMath::Clamp(Along, 0.0f, SegmentLength);
+}
+
+void TrafficSimulation::PickBranchAhead(const FLaneGraph& Graph, const int32 Index, const float ElapsedTime,
+										FTrafficVehicleState& State)
+{
+	const int32 TargetNode = State.TargetNodes[Index];
+	if (TargetNode == INDEX_NONE || State.Routes[Index].IsValidIndex(State.RouteCursors[Index] + 1))
+		return;
+
+	const int32 NumOutEdges = Graph.GetNumOutEdges(TargetNode);
+	const float Distance =
+		Graph.NodeDistances[TargetNode] - State.LaneDistances[Index] - State.Speeds[Index] * ElapsedTime;
+	if (NumOutEdges < 2 || Distance > ReservationDistance)
+		return;
+
+	// Branches without conflicts or right of way rules are still picked when the vehicle reaches them
+	bool bHasRules = false;
+	for (int32 Edge = Graph.OutOffsets[TargetNode]; Edge < Graph.OutOffsets[TargetNode + 1]; ++Edge)
+	{
+		bHasRules |= Graph.GetNumConflicts(Edge) > 0 || Graph.OutPriorities[Edge] != EConnectionPriority::Normal;
+	}
+	if (!bHasRules)
+		return;
+
+	TArray<int32>& Route = State.Routes[Index];
+	Route.Reset();
+	Route.Add(TargetNode);
+	Route.Add(Graph.GetOutEdge(TargetNode, State.RandomStreams[Index].RandHelper(NumOutEdges)));
+	State.RouteCursors[Index] = 0;
+}
+
+bool TrafficSimulation::RequestReservation(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+										   const FTrafficReservationManager& Reservations,
+										   const TArrayView<const int32> HandleToIndex, const int32 Index,
+										   const float ElapsedTime, FTrafficVehicleState& State,
+										   FTrafficReservationRequest& OutRequest)
+{
+	const int32 TargetNode = State.TargetNodes[Index];
+	if (TargetNode == INDEX_NONE)
+		return false;
+
+	OutRequest.Handle = State.Handles[Index];
+	OutRequest.Index = Index;
+	OutRequest.Speed = State.Speeds[Index];
+	OutRequest.bYielding = false;
+	const float Travelled = OutRequest.Speed * ElapsedTime;
+
+	// The vehicle keeps the slot of the edge it is on until it reaches the end
+	const int32 ReservedEdge = Reservations.GetReservedEdge(OutRequest.Handle);
+	if (ReservedEdge != INDEX_NONE && Graph.OutTargets[ReservedEdge] == TargetNode)
+	{
+		OutRequest.Edge = ReservedEdge;
+		OutRequest.Distance = CalculateEdgeStart(Graph, ReservedEdge) - State.LaneDistances[Index] - Travelled;
+		OutRequest.MaxSpeed = CalculateEdgeSpeed(Graph, ReservedEdge);
+		OutRequest.Priority = GetPriorityRank(Graph.OutPriorities[ReservedEdge]);
+		OutRequest.bCommitted = true;
+		State.StoppedNodes[Index] = INDEX_NONE;
+		return true;
+	}
+
+	const float Distance = Graph.NodeDistances[TargetNode] - State.LaneDistances[Index] - Travelled;
+	const int32 NumOutEdges = Graph.GetNumOutEdges(TargetNode);
+	if (Distance > ReservationDistance || NumOutEdges == 0)
+		return false;
+
+	const TArray<int32>& Route = State.Routes[Index];
+	const int32 RouteCursor = State.RouteCursors[Index];
+	int32 NextNode = INDEX_NONE;
+	if (Route.IsValidIndex(RouteCursor + 1))
+	{
+		NextNode = Route[RouteCursor + 1];
+	}
+	else if (NumOutEdges == 1)
+	{
+		NextNode = Graph.GetOutEdge(TargetNode, 0);
+	}
+
+	const int32 Edge = NextNode != INDEX_NONE ? Graph.FindEdge(TargetNode, NextNode) : INDEX_NONE;
+	if (Edge == INDEX_NONE)
+		return false;
+
+	const EConnectionPriority Priority = Graph.OutPriorities[Edge];
+	if (Graph.GetNumConflicts(Edge) == 0 && Priority != EConnectionPriority::Stop)
+		return false;
+
+	OutRequest.Edge = Edge;
+	OutRequest.Distance = FMath::Max(Distance, 0.0f);
+	OutRequest.MaxSpeed = CalculateEdgeSpeed(Graph, Edge);
+	OutRequest.Priority = GetPriorityRank(Priority);
+	OutRequest.bCommitted =
+		Distance < FMath::Square(OutRequest.Speed) / (2.0f * ReservationBrakingDeceleration);
+	if (OutRequest.bCommitted || (Priority != EConnectionPriority::Yield && Priority != EConnectionPriority::Stop))
+		return true;
+
+	// Stop connections are only entered after standing at the stop line
+	if (Priority == EConnectionPriority::Stop && State.StoppedNodes[Index] != TargetNode)
+	{
+		if (OutRequest.Speed > StoppedSpeed || Distance > StopLineDistance)
+		{
+			OutRequest.bYielding = true;
+			return true;
+		}
+		State.StoppedNodes[Index] = TargetNode;
+	}
+
+	// The gap has to last until the vehicle reached the stop line and crossed
+	const float CriticalGap = Priority == EConnectionPriority::Stop ? StopCriticalGap : YieldCriticalGap;
+	const float ArrivalTime =
+		FMath::Max(Distance - StopLineDistance, 0.0f) / FMath::Max(OutRequest.Speed, MinPriorityGapSpeed);
+	OutRequest.bYielding =
+		CalculatePriorityGap(Graph, Occupancy, State, HandleToIndex, Edge) < ArrivalTime + CriticalGap;
+	return true;
+}
+
+float TrafficSimulation::CalculatePriorityGap(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+											  const FTrafficVehicleState& State,
+											  const TArrayView<const int32> HandleToIndex, const int32 Edge)
+{
+	const int32 Rank = GetPriorityRank(Graph.OutPriorities[Edge]);
+	float Gap = MAX_FLT;
+	for (int32 Conflict = Graph.ConflictOffsets[Edge]; Conflict < Graph.ConflictOffsets[Edge + 1]; ++Conflict)
+	{
+		const int32 OtherEdge = Graph.ConflictEdges[Conflict];
+		if (GetPriorityRank(Graph.OutPriorities[OtherEdge]) <= Rank)
+			continue;
+
+		// Vehicles on the other edge are on the lane of its target, the ones approaching it on the lane of its source
+		const int32 FromNode = Graph.OutSources[OtherEdge];
+		const int32 ToNode = Graph.OutTargets[OtherEdge];
+		const int32 FromLane = Graph.NodeLanes[FromNode];
+		const int32 ToLane = Graph.NodeLanes[ToNode];
+		const float ConflictDistance = Graph.ConflictOtherDistances[Conflict];
+		const float EdgeStart = CalculateEdgeStart(Graph, OtherEdge);
+
+		FLaneOccupant Occupant;
+		float Distance = 0.0f;
+		if (Occupancy.FindLastBefore(ToLane, EdgeStart + ConflictDistance, Occupant) &&
+			(FromLane == ToLane || Occupant.Distance >= EdgeStart))
+		{
+			Distance = EdgeStart + ConflictDistance - Occupant.Distance;
+		}
+		else if (FromLane != ToLane && Occupancy.FindLastBefore(FromLane, Graph.NodeDistances[FromNode], Occupant))
+		{
+			Distance = Graph.NodeDistances[FromNode] - Occupant.Distance + ConflictDistance;
+		}
+		else
+		{
+			continue;
+		}
+
+		const int32 OtherIndex = HandleToIndex[Occupant.Handle];
+		if (Distance > PriorityGapDistance || OtherIndex == INDEX_NONE)
+			continue;
+
+		Gap = FMath::Min(Gap, Distance / FMath::Max(State.Speeds[OtherIndex], MinPriorityGapSpeed));
+	}
+	return Gap;
+}
+
+void FTrafficSimulationCore::Initialize(TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> InGraph,
+										const int32 InRandomSeed)
+{
+	Reset();
+	LaneGraph = MoveTemp(InGraph);
+	RandomSeed = InRandomSeed;
+
+	Occupancy.Reset(LaneGraph->GetNumLanes());
+	Reservations.Reset(*LaneGraph);
+	Signals.Reset(*LaneGraph);
+}
+
+void FTrafficSimulationCore::Reset()
+{
+	LaneGraph.Reset();
+	Occupancy.Reset(0);
+	Reservations.Reset();
+	State.Reset();
+	HandleToIndex.Reset();
+	FreeHandles.Reset();
+	Signals.Reset();
+	SignalScheduler.Reset();
+	Time = 0.0;
+	VehicleSeconds = 0.0;
+	NumArrivedVehicles = 0;
+	NumSteps = 0;
+	NumStepInputs = 0;
+	RecordedInputs.Reset();
+}
+
+int32 FTrafficSimulationCore::AddVehicle(const int32 StartNode, const float Speed)
+{
+	if (!LaneGraph.IsValid() || !LaneGraph->IsValidNode(StartNode))
+		return INDEX_NONE;
+
+	RecordInput(ETrafficSimulationInput::AddVehicle, INDEX_NONE, StartNode, Speed);
+	const int32 Handle = FreeHandles.Num() > 0 ? FreeHandles.Pop(false) : HandleToIndex.AddUninitialized();
+	const int32 Index = State.Add(Handle, StartNode);
+	HandleToIndex[Handle] = Index;
+
+	State.RandomStreams[Index].Initialize(HashCombine(RandomSeed, Handle));
+	State.Locations[Index] = LaneGraph->Positions[StartNode];
+	State.Speeds[Index] = Speed;
+	State.KinematicFlags[Index] = 1;
+	State.LODTiers[Index] = ETrafficLODTier::Virtual;
+	State.SimulationOwnedFlags[Index] = 1;
+	return Handle;
+}
+
+void FTrafficSimulationCore::RemoveVehicle(const int32 Handle)
+{
+	if (!IsValidHandle(Handle))
+		return;
+
+	RecordInput(ETrafficSimulationInput::RemoveVehicle, Handle, INDEX_NONE);
+	RemoveVehicleInternal(Handle);
+}
+
+void FTrafficSimulationCore::RemoveVehicleInternal(const int32 Handle)
+{
+	const int32 Index = HandleToIndex[Handle];
+	Occupancy.Remove(Handle);
+	Reservations.RemoveVehicle(State, Index);
+	State.RemoveAtSwap(Index);
+
+	// The last vehicle has been moved into the freed slot
+	if (State.Handles.IsValidIndex(Index))
+		HandleToIndex[State.Handles[Index]] = Index;
+
+	HandleToIndex[Handle] = INDEX_NONE;
+	FreeHandles.Add(Handle);
+}
+
+bool FTrafficSimulationCore::IsValidHandle(const int32 Handle) const
+{
+	return HandleToIndex.IsValidIndex(Handle) && HandleToIndex[Handle] != INDEX_NONE;
+}
+
+int32 FTrafficSimulationCore::GetNumVehicles() const
+{
+	return State.Num();
+}
+
+const FTrafficVehicleState& FTrafficSimulationCore::GetVehicleState() const
+{
+	return State;
+}
+
+TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> FTrafficSimulationCore::GetLaneGraph() const
+{
+	return LaneGraph;
+}
+
+bool FTrafficSimulationCore::SetVehicleRoute(const int32 Handle, const int32 GoalNode)
+{
+	if (!IsValidHandle(Handle))
+		return false;
+
+	RecordInput(ETrafficSimulationInput::SetVehicleRoute, Handle, GoalNode);
+	const int32 Index = HandleToIndex[Handle];
+	TArray<int32>& Route = State.Routes[Index];
+	State.RouteCursors[Index] = 0;
+	if (RoutePlanner.FindRoute(*LaneGraph, State.TargetNodes[Index], GoalNode, Route))
+		return true;
+
+	Route.Reset();
+	return false;
+}
+
+int32 FTrafficSimulationCore::AddSignal(const TArrayView<const int32> Nodes, const bool bStopFlag)
+{
+	return Signals.AddSignal(Nodes, bStopFlag);
+}
+
+void FTrafficSimulationCore::SetSignalStop(const int32 Signal, const bool bStopFlag)
+{
+	if (Signal < 0 || Signal >= Signals.GetNumSignals())
+		return;
+
+	RecordInput(ETrafficSimulationInput::SetSignalStop, Signal, bStopFlag ? 1 : 0);
+	Signals.SetSignalStop(Signal, bStopFlag);
+}
+
+bool FTrafficSimulationCore::IsNodeStop(const int32 Node) const
+{
+	return Signals.IsNodeStop(Node);
+}
+
+FTrafficSignalScheduler& FTrafficSimulationCore::GetSignalScheduler()
+{
+	return SignalScheduler;
+}
+
+void FTrafficSimulationCore::Step(const float DeltaTime)
+{
+	if (!LaneGraph.IsValid())
+		return;
+
+	const FLaneGraph& Graph = *LaneGraph;
+	Time += DeltaTime;
+	++NumSteps;
+	NumStepInputs = 0;
+	VehicleSeconds += static_cast<double>(State.Num()) * DeltaTime;
+
+	// Signals switch before the vehicles decide, like in the subsystem
+	if (SignalScheduler.HasAdaptivePlans())
+		Signals.UpdatePressures(Graph, Occupancy, SignalQueueDistance);
+
+	SignalChanges.Reset();
+	SignalScheduler.Advance(Time, Signals.GetPressures(), SignalChanges);
+	for (const FTrafficSignalChange& Change : SignalChanges)
+	{
+		Signals.SetSignalStop(Change.Signal, Change.bStop);
+	}
+
+	for (int32 Index = 0; Index < State.Num(); ++Index)
+	{
+		State.LaneDistances[Index] = TrafficSimulation::CalculateLaneDistance(Graph, State, Index);
+		Occupancy.Update(State.Handles[Index], Graph.NodeLanes[State.TargetNodes[Index]], State.LaneDistances[Index]);
+	}
+	Occupancy.SortLanes();
+	Reservations.Update(Graph, Occupancy, Signals, HandleToIndex, TArrayView<const uint8>(), 0.0f, State);
+
+	// Decisions only read the positions and speeds of the last step, moves only write the own vehicle
+	const EParallelForFlags Flags = bParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread;
+	ParallelFor(State.Num(), [this, &Graph](const int32 Index)
+	{
+		TrafficSimulation::FindLeader(Graph, Occupancy, State, Index, State.Leaders[Index], State.LeaderGaps[Index]);
+		const bool bStopAtTarget = Signals.IsNodeStop(State.TargetNodes[Index]) || Reservations.IsStop(Index);
+		TrafficSimulation::UpdateFollowing(Graph, HandleToIndex, bStopAtTarget, Index, State);
+	}, Flags);
+
+	DriverModel.CalculateAccelerations(State.Speeds, State.DesiredSpeeds, State.Gaps, State.ApproachingRates,
+									   State.Accelerations);
+
+	ParallelFor(State.Num(), [this, &Graph, DeltaTime](const int32 Index)
+	{
+		const float Speed = FMath::Max(State.Speeds[Index] + State.Accelerations[Index] * DeltaTime, 0.0f);
+		State.Speeds[Index] = Speed;
+		TrafficSimulation::MoveAlongGraph(Graph, Index, Speed * DeltaTime, State);
+	}, Flags);
+
+	// Vehicles at sinks leave, backwards so removing by swap keeps unvisited vehicles in place
+	for (int32 Index = State.Num() - 1; Index >= 0; --Index)
+	{
+		if (State.TargetNodes[Index] == INDEX_NONE)
+		{
+			RemoveVehicleInternal(State.Handles[Index]);
+			++NumArrivedVehicles;
+		}
+	}
+}
+
+double FTrafficSimulationCore::GetTime() const
+{
+	return Time;
+}
+
+double FTrafficSimulationCore::GetVehicleSeconds() const
+{
+	return VehicleSeconds;
+}
+
+int64 FTrafficSimulationCore::GetNumArrivedVehicles() const
+{
+	return NumArrivedVehicles;
+}
+
+int64 FTrafficSimulationCore::GetNumSteps() const
+{
+	return NumSteps;
+}
+
+void FTrafficSimulationCore::SaveSnapshot(TArray<uint8>& OutData) const
+{
+	// Keeps the allocation of the previous snapshot
+	OutData.Reset();
+	FMemoryWriter Writer(OutData);
+
+	uint32 Magic = SnapshotMagic;
+	uint32 Version = SnapshotVersion;
+	uint32 GraphChecksum = LaneGraph.IsValid() ? LaneGraph->CalculateChecksum() : 0;
+	Writer << Magic << Version << GraphChecksum;
+	const_cast<FTrafficSimulationCore*>(this)->Serialize(Writer);
+}
+
+bool FTrafficSimulationCore::LoadSnapshot(const TArray<uint8>& Data)
+{
+	if (!LaneGraph.IsValid())
+		return false;
+
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	uint32 GraphChecksum = 0;
+	Reader << Magic << Version << GraphChecksum;
+	if (Reader.IsError() || Magic != SnapshotMagic || Version != SnapshotVersion)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Traffic snapshot has an unknown format"));
+		return false;
+	}
+
+	if (GraphChecksum != LaneGraph->CalculateChecksum())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Traffic snapshot was taken on a different lane graph"));
+		return false;
+	}
+
+	Serialize(Reader);
+	if (Reader.IsError())
+	{
+		// A partially read state is useless, start over empty
+		UE_LOG(LogTemp, Warning, TEXT("Traffic snapshot is truncated"));
+		const TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> Graph = LaneGraph;
+		Initialize(Graph, RandomSeed);
+		return false;
+	}
+
+	return true;
+}
+
+void FTrafficSimulationCore::SetRecordInputs(const bool bRecord)
+{
+	if (bRecord && !bRecordInputs)
+		RecordedInputs.Reset();
+
+	bRecordInputs = bRecord;
+}
+
+const TArray<FTrafficSimulationInput>& FTrafficSimulationCore::GetRecordedInputs() const
+{
+	return RecordedInputs;
+}
+
+void FTrafficSimulationCore::Replay(const TArrayView<const FTrafficSimulationInput> Inputs, const int64 EndStep,
+								   const float DeltaTime)
+{
+	int32 InputIndex = 0;
+	while (InputIndex < Inputs.Num() && Inputs[InputIndex].Step < NumSteps)
+	{
+		++InputIndex;
+	}
+
+	// Inputs of the current step applied before the snapshot was taken are part of it
+	const int32 FirstStepInput = InputIndex;
+	while (InputIndex < Inputs.Num() && Inputs[InputIndex].Step == NumSteps &&
+		   InputIndex - FirstStepInput < NumStepInputs)
+	{
+		++InputIndex;
+	}
+
+	while (NumSteps < EndStep)
+	{
+		for (; InputIndex < Inputs.Num() && Inputs[InputIndex].Step == NumSteps; ++InputIndex)
+		{
+			ApplyInput(Inputs[InputIndex]);
+		}
+
+		Step(DeltaTime);
+	}
+}
+
+void FTrafficSimulationCore::Serialize(FArchive& Ar)
+{
+	// The lane graph and the recorded inputs are not part of the state
+	State.Serialize(Ar);
+	Occupancy.Serialize(Ar);
+	TrafficSerialization::SerializeArray(Ar, HandleToIndex);
+	TrafficSerialization::SerializeArray(Ar, FreeHandles);
+	Reservations.Serialize(Ar);
+	Signals.Serialize(Ar);
+	SignalScheduler.Serialize(Ar);
+	Ar << RandomSeed << Time << VehicleSeconds << NumArrivedVehicles << NumSteps << NumStepInputs;
+}
+
+void FTrafficSimulationCore::RecordInput(const ETrafficSimulationInput Type, const int32 Target, const int32 Value,
+										 const float Speed)
+{
+	++NumStepInputs;
+	if (!bRecordInputs)
+		return;
+
+	FTrafficSimulationInput& Input = RecordedInputs.AddDefaulted_GetRef();
+	Input.Step = NumSteps;
+	Input.Type = Type;
+	Input.Target = Target;
+	Input.Value = Value;
+	Input.Speed = Speed;
+}
+
+void FTrafficSimulationCore::ApplyInput(const FTrafficSimulationInput& Input)
+{
+	switch (Input.Type)
+	{
+	case ETrafficSimulationInput::AddVehicle:
+		AddVehicle(Input.Value, Input.Speed);
+		break;
+	case ETrafficSimulationInput::RemoveVehicle:
+		RemoveVehicle(Input.Target);
+		break;
+	case ETrafficSimulationInput::SetVehicleRoute:
+		SetVehicleRoute(Input.Target, Input.Value);
+		break;
+	case ETrafficSimulationInput::SetSignalStop:
+		SetSignalStop(Input.Target, Input.Value != 0);
+		break;
+	}
+}
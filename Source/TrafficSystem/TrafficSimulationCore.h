@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IntelligentDriverModel.h"
+#include "LaneOccupancy.h"
+#include "LaneRoutePlanner.h"
+#include "TrafficReservationManager.h"
+#include "TrafficReservationPass.h"
+#include "TrafficSignalScheduler.h"
+#include "TrafficSignalTable.h"
+#include "TrafficVehicleState.h"
+
+struct FLaneGraph;
+
+namespace TrafficSimulation
+{
+	// Distance between the centers of two vehicles touching bumpers
+	constexpr float VehicleLength = 450.0f;
+
+	// FWaypoint::TargetSpeed is given in km/h
+	constexpr float KilometersPerHourToCentimetersPerSecond = 100000.0f / 3600.0f;
+
+	// Vehicles ask for a slot this far in front of an edge with conflicts, see RequestReservation
+	constexpr float ReservationDistance = 4000.0f;
+
+	// Per-vehicle steps of the traffic model shared by FTrafficSimulationCore and UTrafficSimulationSubsystem.
+	// Leaders are stored by handle.
+	TRAFFICSYSTEM_API void FindLeader(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+									  const FTrafficVehicleState& State, int32 Index, int32& OutLeader, float& OutGap);
+
+	// Desired speed from the speed profile of the lane, gap and closing speed towards the leader or the stop at the
+	// target
+	TRAFFICSYSTEM_API void UpdateFollowing(const FLaneGraph& Graph, TArrayView<const int32> HandleToIndex,
+										   bool bStopAtTarget, int32 Index, FTrafficVehicleState& State);
+
+	// Follows the route or picks a random branch, sinks leave the vehicle without a target
+	TRAFFICSYSTEM_API void SelectNextTarget(const FLaneGraph& Graph, int32 Index, FTrafficVehicleState& State);
+
+	// Moves the location by Distance along the lane graph and the shape of spline lanes, passing the waypoints reached
+	TRAFFICSYSTEM_API void MoveAlongGraph(const FLaneGraph& Graph, int32 Index, float Distance,
+										  FTrafficVehicleState& State);
+
+	// Point Lookahead ahead of the vehicle along its lane, continuing into the next lane when the route or a single
+	// connection decides it. Branches picked at random are not known yet, the lookahead stops at the lane end.
+	TRAFFICSYSTEM_API FVector CalculateLookaheadPoint(const FLaneGraph& Graph, const FTrafficVehicleState& State,
+													   int32 Index, float Lookahead);
+
+	// Distance of the vehicle along the lane of its target node
+	TRAFFICSYSTEM_API float CalculateLaneDistance(const FLaneGraph& Graph, const FTrafficVehicleState& State,
+												  int32 Index);
+
+	// Picks the random branch of a vehicle without a route ahead of SelectNextTarget once it is within
+	// ReservationDistance of a node with conflicts or right of way rules on its out edges, the slot depends on it.
+	// ElapsedTime is the time since the state of the vehicle was updated, it is assumed to have moved on at its
+	// speed meanwhile.
+	TRAFFICSYSTEM_API void PickBranchAhead(const FLaneGraph& Graph, int32 Index, float ElapsedTime,
+										   FTrafficVehicleState& State);
+
+	// Request for the edge with conflicts or a stop ahead of the vehicle or the one it is on, false without one or
+	// while the branch ahead is not known yet, see PickBranchAhead. Vehicles on yield and stop connections ask as
+	// yielding until they stood at the stop and the gap is long enough.
+	TRAFFICSYSTEM_API bool RequestReservation(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+											  const FTrafficReservationManager& Reservations,
+											  TArrayView<const int32> HandleToIndex, int32 Index,
+											  float ElapsedTime, FTrafficVehicleState& State,
+											  FTrafficReservationRequest& OutRequest);
+
+	// Seconds until the next vehicle with right of way over Edge reaches one of the conflict points of Edge, MAX_FLT
+	// without one. Only the vehicle closest to each conflict point is looked at, at most two occupancy searches per
+	// conflict.
+	TRAFFICSYSTEM_API float CalculatePriorityGap(const FLaneGraph& Graph, const FLaneOccupancy& Occupancy,
+												 const FTrafficVehicleState& State,
+												 TArrayView<const int32> HandleToIndex, int32 Edge);
+}
+
+// Calls changing a running simulation from the outside, recorded to replay a run
+enum class ETrafficSimulationInput : uint8
+{
+	AddVehicle,
+	RemoveVehicle,
+	SetVehicleRoute,
+	SetSignalStop
+};
+
+struct TRAFFICSYSTEM_API FTrafficSimulationInput
+{
+	// Number of steps done when the input was applied
+	int64 Step = 0;
+
+	ETrafficSimulationInput Type = ETrafficSimulationInput::AddVehicle;
+
+	// Vehicle handle or signal, unused when adding a vehicle
+	int32 Target = INDEX_NONE;
+
+	// Start node, goal node or stop flag
+	int32 Value = INDEX_NONE;
+
+	// Start speed of added vehicles
+	float Speed = 0.0f;
+};
+
+/**
+ * The traffic model without actors, physics or a world: vehicles follow the lane graph kinematically, keep
+ * their distance with the Intelligent Driver Model, stop at signals switched by the signal scheduler, cross
+ * intersections in the slots of the reservation manager and pick branches at random unless they were given a
+ * route. Used for batch experiments and benchmarks, see UTrafficBenchmarkCommandlet.
+ *
+ * Step runs the vehicles in parallel and only reads state written by the previous step, with a random stream
+ * per vehicle, so results are the same for any number of threads. UTrafficSimulationSubsystem is the adapter
+ * for lane, traffic light and car actors and shares the per-vehicle steps above, the signal table and the
+ * reservation pass.
+ *
+ * Runs stepped with the same DeltaTime are reproduced bit for bit: a snapshot holds the complete state and the
+ * input log every outside change with its step, so loading a snapshot and replaying the inputs recorded after
+ * it gives the same result. Signals and plans are set up before the first snapshot, they are part of it.
+ */
+class TRAFFICSYSTEM_API FTrafficSimulationCore
+{
+public:
+	void Initialize(TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> InGraph, int32 InRandomSeed = 1337);
+	void Reset();
+
+	// Places a vehicle on StartNode driving towards it
+	int32 AddVehicle(int32 StartNode, float Speed = 0.0f);
+	void RemoveVehicle(int32 Handle);
+	bool IsValidHandle(int32 Handle) const;
+	int32 GetNumVehicles() const;
+	const FTrafficVehicleState& GetVehicleState() const;
+	TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> GetLaneGraph() const;
+
+	// Plans a route from the target of the vehicle to GoalNode, past its end the vehicle picks branches at random
+	// again until it reaches a sink
+	bool SetVehicleRoute(int32 Handle, int32 GoalNode);
+
+	// Signals and their plans, see UTrafficSimulationSubsystem::AddSignal
+	int32 AddSignal(TArrayView<const int32> Nodes, bool bStopFlag);
+	void SetSignalStop(int32 Signal, bool bStopFlag);
+	bool IsNodeStop(int32 Node) const;
+	FTrafficSignalScheduler& GetSignalScheduler();
+
+	// Advances the simulation, vehicles reaching a sink are removed
+	void Step(float DeltaTime);
+
+	double GetTime() const;
+
+	// Sum of the time simulated for every vehicle
+	double GetVehicleSeconds() const;
+	int64 GetNumArrivedVehicles() const;
+	int64 GetNumSteps() const;
+
+	// Snapshots only load into a simulation initialized with the same lane graph, built by the same binary
+	void SaveSnapshot(TArray<uint8>& OutData) const;
+	bool LoadSnapshot(const TArray<uint8>& Data);
+
+	// Inputs are appended to the log while recording, it is cleared when recording starts
+	void SetRecordInputs(bool bRecord);
+	const TArray<FTrafficSimulationInput>& GetRecordedInputs() const;
+
+	// Steps up to EndStep, applying the inputs of every step before it. Inputs of earlier steps and the ones of the
+	// current step applied before the snapshot are skipped, which allows replaying a whole log from any snapshot
+	// taken while it was recorded.
+	void Replay(TArrayView<const FTrafficSimulationInput> Inputs, int64 EndStep, float DeltaTime);
+
+	FIntelligentDriverModel DriverModel;
+
+	// Distance in front of and behind a signal counted for the pressure of adaptive plans
+	float SignalQueueDistance = 5000.0f;
+
+	bool bParallel = true;
+
+protected:
+	void Serialize(FArchive& Ar);
+	void RecordInput(ETrafficSimulationInput Type, int32 Target, int32 Value, float Speed = 0.0f);
+	void ApplyInput(const FTrafficSimulationInput& Input);
+
+	// Changes made by the simulation itself, not recorded
+	void RemoveVehicleInternal(int32 Handle);
+
+	TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> LaneGraph;
+	FLaneOccupancy Occupancy;
+	FLaneRoutePlanner RoutePlanner;
+	FTrafficVehicleState State;
+	int32 RandomSeed = 0;
+
+	TArray<int32> HandleToIndex;
+	TArray<int32> FreeHandles;
+
+	// Slots at the conflict points of intersections, vehicles without one stop at their target
+	FTrafficReservationPass Reservations;
+
+	FTrafficSignalTable Signals;
+	FTrafficSignalScheduler SignalScheduler;
+	TArray<FTrafficSignalChange> SignalChanges;
+
+	double Time = 0.0;
+	double VehicleSeconds = 0.0;
+	int64 NumArrivedVehicles = 0;
+	int64 NumSteps = 0;
+
+	// Inputs applied since the last step, a snapshot taken in between already contains them
+	int32 NumStepInputs = 0;
+
+	bool bRecordInputs = false;
+	TArray<FTrafficSimulationInput> RecordedInputs;
+};
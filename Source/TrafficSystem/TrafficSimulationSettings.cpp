@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficSimulationSettings.h"
+
+UTrafficSimulationSettings::UTrafficSimulationSettings()
+{
+	FixedStepRate = 30.0f;
+	MaxStepsPerFrame = 4;
+	bEnableLOD = true;
+	FullTierDistance = 5000.0f;
+	ReducedTierDistance = 15000.0f;
+	KinematicTierDistance = 50000.0f;
+	ReducedTierInterval = 2;
+	KinematicTierInterval = 4;
+	VirtualTierInterval = 16;
+	OffscreenDistanceScale = 2.0f;
+	TierHysteresis = 0.1f;
+	VehiclePoolSize = 0;
+	VirtualVehicleHeight = 0.0f;
+	bEnableSpawning = false;
+	DefaultVehicleDensity = 20.0f;
+	MaxSpawnsPerFrame = 4;
+	MaxDespawnsPerFrame = 8;
+	MaxSpawnLanesPerFrame = 64;
+	SpawnClearance = 1000.0f;
+	HiddenSpawnDistance = 50000.0f;
+	SignalQueueDistance = 5000.0f;
+}
+
+float UTrafficSimulationSettings::GetTierDistance(const ETrafficLODTier Tier) const
+{
+	switch (Tier)
+	{
+	case ETrafficLODTier::Full:
+		return FullTierDistance;
+	case ETrafficLODTier::Reduced:
+		return ReducedTierDistance;
+	case ETrafficLODTier::Kinematic:
+		return KinematicTierDistance;
+	default:
+		return MAX_FLT;
+	}
+}
+
+int32 UTrafficSimulationSettings::GetTierInterval(const ETrafficLODTier Tier) const
+{
+	switch (Tier)
+	{
+	case ETrafficLODTier::Reduced:
+		return FMath::Max(ReducedTierInterval, 1);
+	case ETrafficLODTier::Kinematic:
+		return FMath::Max(KinematicTierInterval, 1);
+	case ETrafficLODTier::Virtual:
+		return FMath::Max(VirtualTierInterval, 1);
+	default:
+		return 1;
+	}
+}
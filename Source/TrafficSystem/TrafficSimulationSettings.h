@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CarController.h"
+#include "Engine/DeveloperSettings.h"
+#include "WheeledVehicle.h"
+#include "TrafficVehicleState.h"
+#include "TrafficSimulationSettings.generated.h"
+
+/**
+ * Project settings of the traffic simulation. Vehicles are assigned a LOD tier by their distance to the
+ * closest player view point; coarser tiers are updated less often and stop using vehicle physics.
+ */
+UCLASS(Config = Game, DefaultConfig, meta = (DisplayName = "Traffic Simulation"))
+class TRAFFICSYSTEM_API UTrafficSimulationSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+public:
+	UTrafficSimulationSettings();
+
+	// Simulation steps per second, independent of the frame rate so runs repeat exactly. Zero steps once per frame
+	// with the frame time.
+	UPROPERTY(Config, EditAnywhere, Category = "Simulation", meta = (ClampMin = 0))
+	float FixedStepRate;
+
+	// Steps run by one frame at most, a frame taking longer drops the remaining time
+	UPROPERTY(Config, EditAnywhere, Category = "Simulation", meta = (ClampMin = 1))
+	int32 MaxStepsPerFrame;
+
+	// Without LOD every vehicle is simulated with physics every step
+	UPROPERTY(Config, EditAnywhere, Category = "LOD")
+	bool bEnableLOD;
+
+	// Vehicles closer than this are updated every step
+	UPROPERTY(Config, EditAnywhere, Category = "LOD", meta = (ClampMin = 0))
+	float FullTierDistance;
+
+	// Vehicles closer than this still use physics but update their driving less often
+	UPROPERTY(Config, EditAnywhere, Category = "LOD", meta = (ClampMin = 0))
+	float ReducedTierDistance;
+
+	// Vehicles closer than this are moved kinematically, farther vehicles are virtual
+	UPROPERTY(Config, EditAnywhere, Category = "LOD", meta = (ClampMin = 0))
+	float KinematicTierDistance;
+
+	// Steps between two updates of a vehicle in each tier, updates are staggered over these steps
+	UPROPERTY(Config, EditAnywhere, Category = "LOD", meta = (ClampMin = 1))
+	int32 ReducedTierInterval;
+
+	UPROPERTY(Config, EditAnywhere, Category = "LOD", meta = (ClampMin = 1))
+	int32 KinematicTierInterval;
+
+	UPROPERTY(Config, EditAnywhere, Category = "LOD", meta = (ClampMin = 1))
+	int32 VirtualTierInterval;
+
+	// Distance multiplier for vehicles behind the view point
+	UPROPERTY(Config, EditAnywhere, Category = "LOD", meta = (ClampMin = 1))
+	float OffscreenDistanceScale;
+
+	// Vehicles only move to a coarser tier this fraction beyond its threshold to avoid toggling at the border
+	UPROPERTY(Config, EditAnywhere, Category = "LOD", meta = (ClampMin = 0, ClampMax = 1))
+	float TierHysteresis;
+
+	// Pawn class lent to virtual vehicles near a view point, no pool is created without one
+	UPROPERTY(Config, EditAnywhere, Category = "Pool")
+	TSoftClassPtr<AWheeledVehicle> PooledVehicleClass;
+
+	// Controller possessing the pooled pawns, ACarController if not set
+	UPROPERTY(Config, EditAnywhere, Category = "Pool")
+	TSoftClassPtr<ACarController> PooledControllerClass;
+
+	// Pawns spawned at BeginPlay, at most this many virtual vehicles have an actor at the same time
+	UPROPERTY(Config, EditAnywhere, Category = "Pool", meta = (ClampMin = 0))
+	int32 VehiclePoolSize;
+
+	// Height of the actor origin above the lane for vehicles that start virtual
+	UPROPERTY(Config, EditAnywhere, Category = "Pool")
+	float VirtualVehicleHeight;
+
+	// Keeps lanes filled with virtual vehicles up to their density and removes them at sinks
+	UPROPERTY(Config, EditAnywhere, Category = "Spawning")
+	bool bEnableSpawning;
+
+	// Vehicles per kilometer of lane, ALane::VehicleDensity overrides it per lane
+	UPROPERTY(Config, EditAnywhere, Category = "Spawning", meta = (ClampMin = 0))
+	float DefaultVehicleDensity;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Spawning", meta = (ClampMin = 0))
+	int32 MaxSpawnsPerFrame;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Spawning", meta = (ClampMin = 0))
+	int32 MaxDespawnsPerFrame;
+
+	// Lanes checked for missing vehicles per frame, the spawner cycles through all lanes
+	UPROPERTY(Config, EditAnywhere, Category = "Spawning", meta = (ClampMin = 1))
+	int32 MaxSpawnLanesPerFrame;
+
+	// Free distance needed at the start of a lane to spawn there
+	UPROPERTY(Config, EditAnywhere, Category = "Spawning", meta = (ClampMin = 0))
+	float SpawnClearance;
+
+	// Lanes that are not entry points of the network only spawn when no view point is closer than this
+	UPROPERTY(Config, EditAnywhere, Category = "Spawning", meta = (ClampMin = 0))
+	float HiddenSpawnDistance;
+
+	// Distance in front of and behind a signal in which vehicles count towards its queue for adaptive timing
+	UPROPERTY(Config, EditAnywhere, Category = "Signals", meta = (ClampMin = 0))
+	float SignalQueueDistance;
+
+	float GetTierDistance(ETrafficLODTier Tier) const;
+	int32 GetTierInterval(ETrafficLODTier Tier) const;
+};
@@ -0,0 +1,1382 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficSimulationSubsystem.h"
+
+#include "CarController.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "DrawDebugHelpers.h"
+#include "EngineDefines.h"
+#include "EngineUtils.h"
+#include "Async/ParallelFor.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/WorldSettings.h"
+#include "Lane.h"
+#include "TrafficCorridor.h"
+#include "TrafficLandmarkData.h"
+#include "TrafficLight.h"
+#include "TrafficLightsController.h"
+#include "TrafficSimulationCore.h"
+#include "TrafficSimulationSettings.h"
+#include "TrafficSteeringKernel.h"
+#include "TrafficSystem.h"
+#include "WheeledVehicle.h"
+#include "WheeledVehicleMovementComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Traffic Simulation Tick"), STAT_TrafficSimulationTick, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Simulated Vehicles"), STAT_TrafficSimulatedVehicles, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Updated Vehicles"), STAT_TrafficUpdatedVehicles, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pooled Vehicles In Use"), STAT_TrafficPooledVehiclesInUse, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Spawned Vehicles"), STAT_TrafficSpawnedVehicles, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Despawned Vehicles"), STAT_TrafficDespawnedVehicles, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LOD Full Vehicles"), STAT_TrafficLODFullVehicles, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LOD Reduced Vehicles"), STAT_TrafficLODReducedVehicles, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LOD Kinematic Vehicles"), STAT_TrafficLODKinematicVehicles, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LOD Virtual Vehicles"), STAT_TrafficLODVirtualVehicles, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Signal Changes"), STAT_TrafficSignalChanges, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Reservation Requests"), STAT_TrafficReservationRequests, STATGROUP_TrafficSystem);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Signal Throughput (veh/h)"), STAT_TrafficSignalThroughput, STATGROUP_TrafficSystem);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Signal Average Delay (s)"), STAT_TrafficSignalAverageDelay, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Route Queries Pending"), STAT_TrafficRouteQueriesPending, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Route Queries In Flight"), STAT_TrafficRouteQueriesInFlight, STATGROUP_TrafficSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Route Queries Completed"), STAT_TrafficRouteQueriesCompleted, STATGROUP_TrafficSystem);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Route Query Latency (ms)"), STAT_TrafficRouteQueryLatency, STATGROUP_TrafficSystem);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Route Query Expanded Nodes"), STAT_TrafficRouteQueryExpandedNodes, STATGROUP_TrafficSystem);
+DECLARE_MEMORY_STAT(TEXT("Route Landmark Tables"), STAT_TrafficRouteLandmarkMemory, STATGROUP_TrafficSystem);
+
+static TAutoConsoleVariable<int32> CVarTrafficDebugDraw(
+	TEXT("Traffic.DebugDraw"),
+	0,
+	TEXT("Draw steering and collision debug lines for all simulated vehicles."),
+	ECVF_Cheat);
+
+static TAutoConsoleVariable<int32> CVarTrafficObstacleTraces(
+	TEXT("Traffic.ObstacleTraces"),
+	0,
+	TEXT("Trace ahead of vehicles for obstacles that are not simulated vehicles, except on reserved intersections."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarTrafficParallelUpdate(
+	TEXT("Traffic.ParallelUpdate"),
+	1,
+	TEXT("Update the driving decisions of all vehicles on worker threads."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarTrafficRouteQueriesPerFrame(
+	TEXT("Traffic.RouteQueries.MaxPerFrame"),
+	256,
+	TEXT("Maximum number of route queries dispatched to worker threads per frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarTrafficRouteQueryBatchSize(
+	TEXT("Traffic.RouteQueries.BatchSize"),
+	32,
+	TEXT("Number of route queries searched by one worker task."),
+	ECVF_Default);
+
+namespace
+{
+	// A waypoint counts as reached once the vehicle is within this 2D distance
+	constexpr float WaypointReachedDistance = 50.0f;
+
+	// Pure pursuit lookahead along the lane, growing with the speed so fast vehicles do not oscillate. Waypoints
+	// already behind the vehicle within the shortest lookahead count as passed.
+	constexpr float MinLookaheadDistance = 300.0f;
+	constexpr float LookaheadTime = 0.6f;
+
+	// In curves the lookahead is shortened to an arc of at most this angle in radians, a long one cuts the corner
+	constexpr float MaxLookaheadAngle = 0.5f;
+
+	// Steering input per curvature of the pursuit arc, 2 * wheel base / maximum steer angle of a typical car
+	// (270 cm, 50 degrees)
+	constexpr float PursuitSteeringGain = 2.0f * 270.0f / 0.8727f;
+
+	constexpr float CollisionTraceDistance = 700.0f;
+	constexpr float CollisionTraceHeight = 50.0f;
+
+	// Spawn densities are given in vehicles per km
+	constexpr float CentimetersPerKilometer = 100000.0f;
+
+	constexpr int32 DefaultRandomSeed = 1337;
+
+	// Vehicles slower than this in front of a signal are delayed by it
+	constexpr float SignalDelaySpeed = 100.0f;
+
+	// Pooled actors are parked this far above the kill height of the level
+	constexpr float PoolParkingHeight = 100000.0f;
+}
+
+bool UTrafficSimulationSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UTrafficSimulationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LaneGraph = MakeShared<FLaneGraph, ESPMode::ThreadSafe>();
+}
+
+void UTrafficSimulationSubsystem::Deinitialize()
+{
+	RouteQueries.Reset();
+	PendingRouteHandles.Reset();
+	LaneGraph.Reset();
+	Landmarks.Reset();
+	SpatialIndex.Reset();
+	Occupancy.Reset(0);
+	Reservations.Reset();
+	Signals.Reset();
+	SignalSubscribers.Reset();
+	SignalLights.Reset();
+	SignalScheduler.Reset();
+	SignalMetrics = FTrafficSignalMetrics();
+	SimulationTime = 0.0;
+	LaneActors.Reset();
+	LaneIndices.Reset();
+	bLaneGraphBuilt = false;
+
+	State.Reset();
+	Vehicles.Reset();
+	Controllers.Reset();
+	HandleToIndex.Reset();
+	FreeHandles.Reset();
+
+	PooledVehicles.Reset();
+	PooledControllers.Reset();
+	FreePoolSlots.Reset();
+	LaneTargetVehicleCounts.Reset();
+
+	Super::Deinitialize();
+}
+
+void UTrafficSimulationSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	BuildLaneGraph();
+	ResolveTrafficLights();
+	ResolveSignalPlans();
+	CreateVehiclePool();
+}
+
+void UTrafficSimulationSubsystem::BuildLaneGraph()
+{
+	TArray<ALane*> Lanes;
+	FLaneGraph::GatherLanes(GetWorld(), Lanes);
+
+	// Route queries keep searching this snapshot on worker threads, the graph is never modified after the build
+	TSharedRef<FLaneGraph, ESPMode::ThreadSafe> NewLaneGraph = MakeShared<FLaneGraph, ESPMode::ThreadSafe>();
+	FLaneGraph::Build(Lanes, *NewLaneGraph);
+	LaneGraph = NewLaneGraph;
+
+	SpatialIndex.Build(*LaneGraph);
+	Occupancy.Reset(LaneGraph->GetNumLanes());
+	Reservations.Reset(*LaneGraph);
+	LoadLandmarks();
+	RouteQueries.SetGraph(LaneGraph, Landmarks);
+	PendingRouteHandles.Reset();
+	Signals.Reset(*LaneGraph);
+	SignalSubscribers.Reset();
+	SignalLights.Reset();
+	SignalScheduler.Reset();
+
+	LaneActors.Reset(Lanes.Num());
+	LaneIndices.Reset();
+	for (int32 LaneIndex = 0; LaneIndex < Lanes.Num(); ++LaneIndex)
+	{
+		LaneActors.Add(Lanes[LaneIndex]);
+		LaneIndices.Add(Lanes[LaneIndex], LaneIndex);
+	}
+
+	// Vehicle count the spawner keeps on every lane
+	const float DefaultVehicleDensity = GetDefault<UTrafficSimulationSettings>()->DefaultVehicleDensity;
+	LaneTargetVehicleCounts.Reset(Lanes.Num());
+	for (int32 LaneIndex = 0; LaneIndex < Lanes.Num(); ++LaneIndex)
+	{
+		const int32 NumNodes = LaneGraph->LaneNumNodes[LaneIndex];
+		const float LaneLength =
+			NumNodes > 0 ? LaneGraph->NodeDistances[LaneGraph->LaneFirstNodes[LaneIndex] + NumNodes - 1] : 0.0f;
+		const float Density = Lanes[LaneIndex]->VehicleDensity >= 0.0f ? Lanes[LaneIndex]->VehicleDensity
+																		: DefaultVehicleDensity;
+		LaneTargetVehicleCounts.Add(FMath::FloorToInt(Density * LaneLength / CentimetersPerKilometer));
+	}
+	SpawnLaneCursor = 0;
+
+	bLaneGraphBuilt = true;
+}
+
+void UTrafficSimulationSubsystem::LoadLandmarks()
+{
+	Landmarks.Reset();
+	for (TActorIterator<ATrafficLandmarkData> It(GetWorld()); It; ++It)
+	{
+		const FLaneLandmarks& LevelLandmarks = It->GetLandmarks();
+		if (!LevelLandmarks.IsCompatible(*LaneGraph))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Route landmarks of %s do not match the lane graph, rebuild them"),
+				   *It->GetName());
+			continue;
+		}
+
+		Landmarks = MakeShared<FLaneLandmarks, ESPMode::ThreadSafe>(LevelLandmarks);
+		break;
+	}
+
+	SET_MEMORY_STAT(STAT_TrafficRouteLandmarkMemory, Landmarks.IsValid() ? Landmarks->GetAllocatedSize() : 0);
+}
+
+void UTrafficSimulationSubsystem::ResolveTrafficLights()
+{
+	for (TActorIterator<ATrafficLight> It(GetWorld()); It; ++It)
+	{
+		ATrafficLight* TrafficLight = *It;
+		if (!IsValid(TrafficLight))
+			continue;
+
+		TArray<int32> Nodes;
+		for (const FConnection& ConnectedWaypoint : TrafficLight->ConnectedWaypoints)
+		{
+			const int32 Node = FindNode(ConnectedWaypoint.Lane.Get(), ConnectedWaypoint.Id);
+			if (Node != INDEX_NONE)
+				Nodes.Add(Node);
+		}
+
+		TrafficLight->SignalIndex = AddSignal(Nodes, TrafficLight->bStop);
+		SignalLights[TrafficLight->SignalIndex] = TrafficLight;
+	}
+}
+
+void UTrafficSimulationSubsystem::ResolveSignalPlans()
+{
+	// Controllers along a green wave corridor share its cycle and start at their offset
+	TMap<const ATrafficLightsController*, TPair<const ATrafficCorridor*, int32>> CorridorIntersections;
+	for (TActorIterator<ATrafficCorridor> It(GetWorld()); It; ++It)
+	{
+		const ATrafficCorridor* Corridor = *It;
+		if (!IsValid(Corridor) || !Corridor->IsBuilt())
+			continue;
+
+		for (int32 Index = 0; Index < Corridor->Intersections.Num(); ++Index)
+		{
+			CorridorIntersections.Add(Corridor->Intersections[Index].Controller, MakeTuple(Corridor, Index));
+		}
+	}
+
+	TArray<FTrafficSignalPhase> Phases;
+	for (TActorIterator<ATrafficLightsController> It(GetWorld()); It; ++It)
+	{
+		const ATrafficLightsController* Controller = *It;
+		if (!IsValid(Controller))
+			continue;
+
+		// Every group of the controller is one phase, all of its lights stop until the plan starts
+		Phases.Reset();
+		for (const FTrafficLightGroup& Group : Controller->GetGroups())
+		{
+			FTrafficSignalPhase& Phase = Phases.AddDefaulted_GetRef();
+			Phase.GoDuration = Group.GoDuration;
+			Phase.WaitDuration = Group.WaitAfterStopDuration;
+			for (const ATrafficLight* TrafficLight : Group.TrafficLights)
+			{
+				if (!IsValid(TrafficLight) || TrafficLight->SignalIndex == INDEX_NONE)
+					continue;
+
+				Phase.Signals.Add(TrafficLight->SignalIndex);
+				SetSignalStop(TrafficLight->SignalIndex, true);
+			}
+		}
+
+		if (Controller->Timing == ETrafficSignalTiming::MaxPressure)
+		{
+			if (CorridorIntersections.Contains(Controller))
+				UE_LOG(LogTemp, Warning, TEXT("%s uses max pressure timing and is not coordinated with its corridor"),
+					   *Controller->GetName());
+
+			FTrafficSignalAdaptiveTiming AdaptiveTiming;
+			AdaptiveTiming.MinGoDuration = Controller->MinGoDuration;
+			AdaptiveTiming.ExtensionInterval = Controller->ExtensionInterval;
+			SignalScheduler.AddPlan(Phases, SimulationTime, &AdaptiveTiming);
+			continue;
+		}
+
+		double StartTime = SimulationTime;
+		if (const TPair<const ATrafficCorridor*, int32>* CorridorIntersection = CorridorIntersections.Find(Controller))
+			StartTime = CalculateCoordinatedStartTime(*CorridorIntersection->Key, CorridorIntersection->Value, Phases);
+
+		SignalScheduler.AddPlan(Phases, StartTime);
+	}
+}
+
+double UTrafficSimulationSubsystem::CalculateCoordinatedStartTime(const ATrafficCorridor& Corridor,
+																  const int32 IntersectionIndex,
+																  TArray<FTrafficSignalPhase>& Phases) const
+{
+	const FTrafficCorridorIntersection& Intersection = Corridor.Intersections[IntersectionIndex];
+	if (!Phases.IsValidIndex(Intersection.GroupIndex))
+		return SimulationTime;
+
+	// The corridor group takes up the slack to the common cycle
+	float Cycle = 0.0f;
+	for (const FTrafficSignalPhase& Phase : Phases)
+	{
+		Cycle += Phase.GoDuration + Phase.WaitDuration;
+	}
+
+	if (Cycle > Corridor.CycleLength)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s has a longer cycle than the green wave %s, rebuild it"),
+			   *Intersection.Controller->GetName(), *Corridor.GetName());
+		return SimulationTime;
+	}
+	Phases[Intersection.GroupIndex].GoDuration += Corridor.CycleLength - Cycle;
+
+	// Start the plan so the corridor group goes at the offset, the lights stop until then
+	float GroupStart = 0.0f;
+	for (int32 Phase = 0; Phase < Intersection.GroupIndex; ++Phase)
+	{
+		GroupStart += Phases[Phase].GoDuration + Phases[Phase].WaitDuration;
+	}
+
+	const float Delay = FMath::Fmod(Intersection.Offset - GroupStart, Corridor.CycleLength);
+	return SimulationTime + (Delay < 0.0f ? Delay + Corridor.CycleLength : Delay);
+}
+
+void UTrafficSimulationSubsystem::UpdateSignals(const float DeltaTime)
+{
+	SimulationTime += DeltaTime;
+
+	// Pressures use the occupancy of the last frame, vehicles in coarse tiers count at their last update
+	if (SignalScheduler.HasAdaptivePlans())
+		Signals.UpdatePressures(*LaneGraph, Occupancy, GetDefault<UTrafficSimulationSettings>()->SignalQueueDistance);
+
+	// All phase changes due this frame are applied in one batch before the vehicles are updated
+	SignalChanges.Reset();
+	SignalScheduler.Advance(SimulationTime, Signals.GetPressures(), SignalChanges);
+	for (const FTrafficSignalChange& Change : SignalChanges)
+	{
+		SetSignalStop(Change.Signal, Change.bStop);
+	}
+	SET_DWORD_STAT(STAT_TrafficSignalChanges, SignalChanges.Num());
+	SET_FLOAT_STAT(STAT_TrafficSignalThroughput, SignalMetrics.GetThroughputPerHour(SimulationTime));
+	SET_FLOAT_STAT(STAT_TrafficSignalAverageDelay, SignalMetrics.GetAverageDelaySeconds());
+}
+
+const FLaneGraph& UTrafficSimulationSubsystem::GetLaneGraph() const
+{
+	return *LaneGraph;
+}
+
+bool UTrafficSimulationSubsystem::HasLaneGraph() const
+{
+	return bLaneGraphBuilt;
+}
+
+const FLaneSpatialIndex& UTrafficSimulationSubsystem::GetSpatialIndex() const
+{
+	return SpatialIndex;
+}
+
+int32 UTrafficSimulationSubsystem::GetLaneIndex(const ALane* Lane) const
+{
+	const int32* LaneIndex = Lane ? LaneIndices.Find(Lane) : nullptr;
+	return LaneIndex ? *LaneIndex : INDEX_NONE;
+}
+
+ALane* UTrafficSimulationSubsystem::GetLaneActor(const int32 LaneIndex) const
+{
+	return LaneActors.IsValidIndex(LaneIndex) ? LaneActors[LaneIndex].Get() : nullptr;
+}
+
+int32 UTrafficSimulationSubsystem::FindNode(const ALane* Lane, const int32 WaypointId) const
+{
+	const int32 LaneIndex = GetLaneIndex(Lane);
+	if (LaneIndex == INDEX_NONE || !Lane->HasWaypointId(WaypointId))
+		return INDEX_NONE;
+
+	const int32 WaypointIndex = Lane->GetWaypointIndex(WaypointId);
+	if (WaypointIndex >= LaneGraph->LaneNumNodes[LaneIndex])
+		return INDEX_NONE;
+
+	return LaneGraph->GetNodeIndex(LaneIndex, WaypointIndex);
+}
+
+bool UTrafficSimulationSubsystem::FindRoute(const int32 StartNode, const int32 GoalNode, TArray<int32>& OutRoute)
+{
+	return RoutePlanner.FindRoute(*LaneGraph, StartNode, GoalNode, OutRoute, Landmarks.Get());
+}
+
+bool UTrafficSimulationSubsystem::SetVehicleDestination(const int32 Handle, const FVector& Destination)
+{
+	if (!IsValidHandle(Handle))
+		return false;
+
+	const int32 Index = HandleToIndex[Handle];
+	State.Routes[Index].Reset();
+	State.RouteCursors[Index] = 0;
+	State.RouteTickets[Index] = INDEX_NONE;
+
+	// Route to the end of the closest segment so the vehicle passes the destination
+	FLaneGraphLocation DestinationLocation;
+	if (State.TargetNodes[Index] == INDEX_NONE ||
+		!SpatialIndex.FindNearest(Destination, WORLD_MAX, DestinationLocation))
+		return false;
+
+	SubmitRouteQuery(Index, DestinationLocation.ToNode);
+	return true;
+}
+
+void UTrafficSimulationSubsystem::SubmitRouteQuery(const int32 Index, const int32 GoalNode)
+{
+	const int32 Ticket = RouteQueries.Submit(State.TargetNodes[Index], GoalNode);
+	State.RouteTickets[Index] = Ticket;
+	PendingRouteHandles.Add(Ticket, State.Handles[Index]);
+}
+
+void UTrafficSimulationSubsystem::UpdateRouteQueries()
+{
+	RouteQueries.MaxQueriesPerUpdate = CVarTrafficRouteQueriesPerFrame.GetValueOnGameThread();
+	RouteQueries.BatchSize = CVarTrafficRouteQueryBatchSize.GetValueOnGameThread();
+
+	RouteQueryResults.Reset();
+	RouteQueries.Update(RouteQueryResults);
+
+	for (FLaneRouteQueryResult& Result : RouteQueryResults)
+	{
+		// Results of removed vehicles or superseded queries are dropped
+		int32 Handle = INDEX_NONE;
+		if (!PendingRouteHandles.RemoveAndCopyValue(Result.Ticket, Handle) || !IsValidHandle(Handle))
+			continue;
+
+		const int32 Index = HandleToIndex[Handle];
+		if (State.RouteTickets[Index] != Result.Ticket)
+			continue;
+
+		State.RouteTickets[Index] = INDEX_NONE;
+		if (!Result.bSuccess)
+			continue;
+
+		// The vehicle kept driving while the query was running, continue from its current target
+		const int32 RouteCursor = Result.Route.Find(State.TargetNodes[Index]);
+		if (RouteCursor == INDEX_NONE)
+		{
+			if (State.TargetNodes[Index] != INDEX_NONE)
+				SubmitRouteQuery(Index, Result.Route.Last());
+			continue;
+		}
+
+		State.Routes[Index] = MoveTemp(Result.Route);
+		State.RouteCursors[Index] = RouteCursor;
+	}
+
+	const FLaneRouteQueryStats& Stats = RouteQueries.GetStats();
+	SET_DWORD_STAT(STAT_TrafficRouteQueriesPending, Stats.NumPending);
+	SET_DWORD_STAT(STAT_TrafficRouteQueriesInFlight, Stats.NumInFlight);
+	SET_DWORD_STAT(STAT_TrafficRouteQueriesCompleted, Stats.NumCompletedLastUpdate);
+	SET_FLOAT_STAT(STAT_TrafficRouteQueryLatency, Stats.AverageLatencySeconds * 1000.0);
+	SET_FLOAT_STAT(STAT_TrafficRouteQueryExpandedNodes, Stats.AverageExpandedNodes);
+}
+
+const FLaneRouteQueryStats& UTrafficSimulationSubsystem::GetRouteQueryStats() const
+{
+	return RouteQueries.GetStats();
+}
+
+void UTrafficSimulationSubsystem::SetNodeStop(const int32 Node, const bool bStopFlag)
+{
+	Signals.SetNodeStop(Node, bStopFlag);
+}
+
+bool UTrafficSimulationSubsystem::IsNodeStop(const int32 Node) const
+{
+	return Signals.IsNodeStop(Node);
+}
+
+int32 UTrafficSimulationSubsystem::AddSignal(const TArrayView<const int32> Nodes, const bool bStopFlag)
+{
+	// The waypoint flag only mirrors the light in the editor, the signal owns the stop state from now on
+	SignalSubscribers.AddDefaulted();
+	SignalLights.AddDefaulted();
+	return Signals.AddSignal(Nodes, bStopFlag);
+}
+
+void UTrafficSimulationSubsystem::SetSignalStop(const int32 Signal, const bool bStopFlag)
+{
+	if (!Signals.SetSignalStop(Signal, bStopFlag))
+		return;
+
+	if (ATrafficLight* TrafficLight = SignalLights[Signal].Get())
+		TrafficLight->bStop = bStopFlag;
+
+	// Wake the subscribers up and drop the ones that moved on or were removed
+	TArray<int32>& Subscribers = SignalSubscribers[Signal];
+	for (int32 Subscriber = Subscribers.Num() - 1; Subscriber >= 0; --Subscriber)
+	{
+		const int32 Handle = Subscribers[Subscriber];
+		if (!IsValidHandle(Handle) || State.Signals[HandleToIndex[Handle]] != Signal)
+		{
+			Subscribers.RemoveAtSwap(Subscriber, 1, false);
+			continue;
+		}
+
+		State.WakeFlags[HandleToIndex[Handle]] = 1;
+	}
+}
+
+bool UTrafficSimulationSubsystem::IsSignalStop(const int32 Signal) const
+{
+	return Signals.IsSignalStop(Signal);
+}
+
+int32 UTrafficSimulationSubsystem::GetNumSignals() const
+{
+	return Signals.GetNumSignals();
+}
+
+const FTrafficSignalScheduler& UTrafficSimulationSubsystem::GetSignalScheduler() const
+{
+	return SignalScheduler;
+}
+
+double UTrafficSimulationSubsystem::GetSimulationTime() const
+{
+	return SimulationTime;
+}
+
+int64 UTrafficSimulationSubsystem::GetNumSteps() const
+{
+	return NumSteps;
+}
+
+const FTrafficSignalMetrics& UTrafficSimulationSubsystem::GetSignalMetrics() const
+{
+	return SignalMetrics;
+}
+
+void UTrafficSimulationSubsystem::ResetSignalMetrics()
+{
+	SignalMetrics = FTrafficSignalMetrics();
+	SignalMetrics.StartTime = SimulationTime;
+}
+
+bool UTrafficSimulationSubsystem::IsTickable() const
+{
+	if (HasAnyFlags(RF_ClassDefaultObject))
+		return false;
+
+	return State.Num() > 0 || PendingRouteHandles.Num() > 0 ||
+		(bLaneGraphBuilt && GetDefault<UTrafficSimulationSettings>()->bEnableSpawning);
+}
+
+TStatId UTrafficSimulationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTrafficSimulationSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* UTrafficSimulationSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+int32 UTrafficSimulationSubsystem::RegisterVehicle(ACarController* Controller, AWheeledVehicle* Vehicle, ALane* Lane,
+												   const int32 WaypointIndex)
+{
+	check(Vehicle);
+
+	const int32 Handle = AllocateHandle();
+
+	// Translate the lane reference once, the per-frame update only works on node indices
+	int32 TargetNode = INDEX_NONE;
+	const int32 LaneIndex = GetLaneIndex(Lane);
+	if (LaneIndex != INDEX_NONE && WaypointIndex >= 0 && WaypointIndex < LaneGraph->LaneNumNodes[LaneIndex])
+	{
+		TargetNode = LaneGraph->GetNodeIndex(LaneIndex, WaypointIndex);
+	}
+
+	const int32 Index = State.Add(Handle, TargetNode);
+	State.RandomStreams[Index].Initialize(HashCombine(DefaultRandomSeed, Handle));
+	Vehicles.Add(Vehicle);
+	Controllers.Add(Controller);
+	HandleToIndex[Handle] = Index;
+
+	return Handle;
+}
+
+int32 UTrafficSimulationSubsystem::AddVirtualVehicle(const int32 StartNode)
+{
+	const FLaneGraph& Graph = *LaneGraph;
+	if (!Graph.IsValidNode(StartNode))
+		return INDEX_NONE;
+
+	const int32 Handle = AllocateHandle();
+	const int32 Index = State.Add(Handle, StartNode);
+	State.RandomStreams[Index].Initialize(HashCombine(DefaultRandomSeed, Handle));
+	Vehicles.Add(nullptr);
+	Controllers.Add(nullptr);
+	HandleToIndex[Handle] = Index;
+
+	// Virtual vehicles start on the node and only get an actor from the pool near a view point
+	State.SimulationOwnedFlags[Index] = 1;
+	State.KinematicFlags[Index] = 1;
+	State.LODTiers[Index] = ETrafficLODTier::Virtual;
+	State.HeightOffsets[Index] = GetDefault<UTrafficSimulationSettings>()->VirtualVehicleHeight;
+	State.Locations[Index] = Graph.Positions[StartNode] + FVector(0.0f, 0.0f, State.HeightOffsets[Index]);
+	State.PreviousLocations[Index] = State.Locations[Index];
+	if (Graph.GetNumOutEdges(StartNode) > 0)
+	{
+		const FVector ToNext = Graph.Positions[Graph.GetOutEdge(StartNode, 0)] - Graph.Positions[StartNode];
+		State.Forwards[Index] = ToNext.GetSafeNormal(SMALL_NUMBER, FVector::ForwardVector);
+	}
+
+	return Handle;
+}
+
+int32 UTrafficSimulationSubsystem::AllocateHandle()
+{
+	if (FreeHandles.Num() > 0)
+		return FreeHandles.Pop(false);
+
+	return HandleToIndex.AddUninitialized();
+}
+
+void UTrafficSimulationSubsystem::UnregisterVehicle(const int32 Handle)
+{
+	if (!IsValidHandle(Handle))
+		return;
+
+	const int32 Index = HandleToIndex[Handle];
+	if (State.PoolSlots[Index] != INDEX_NONE)
+	{
+		ReleasePooledVehicle(Index);
+	}
+	else if (State.KinematicFlags[Index] && Vehicles[Index])
+	{
+		SetVehicleKinematic(Index, false);
+	}
+
+	Occupancy.Remove(Handle);
+	Reservations.RemoveVehicle(State, Index);
+	State.RemoveAtSwap(Index);
+	Vehicles.RemoveAtSwap(Index, 1, false);
+	Controllers.RemoveAtSwap(Index, 1, false);
+
+	// The last vehicle has been moved into the freed slot
+	if (State.Handles.IsValidIndex(Index))
+	{
+		HandleToIndex[State.Handles[Index]] = Index;
+	}
+
+	HandleToIndex[Handle] = INDEX_NONE;
+	FreeHandles.Add(Handle);
+}
+
+bool UTrafficSimulationSubsystem::IsValidHandle(const int32 Handle) const
+{
+	return HandleToIndex.IsValidIndex(Handle) && HandleToIndex[Handle] != INDEX_NONE;
+}
+
+int32 UTrafficSimulationSubsystem::GetNumVehicles() const
+{
+	return State.Num();
+}
+
+const FTrafficVehicleState& UTrafficSimulationSubsystem::GetVehicleState() const
+{
+	return State;
+}
+
+void UTrafficSimulationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TrafficSimulationTick);
+	SET_DWORD_STAT(STAT_TrafficSimulatedVehicles, State.Num());
+
+	const UTrafficSimulationSettings* Settings = GetDefault<UTrafficSimulationSettings>();
+	if (Settings->FixedStepRate <= 0.0f)
+	{
+		Step(DeltaTime);
+		UpdateKinematicActors(DeltaTime);
+		return;
+	}
+
+	// Steps of a fixed length make the simulation independent of the frame rate, actors are drawn up to one
+	// step behind it
+	const double StepSeconds = 1.0 / Settings->FixedStepRate;
+	StepAccumulator = FMath::Min(StepAccumulator + DeltaTime, StepSeconds * FMath::Max(Settings->MaxStepsPerFrame, 1));
+	while (StepAccumulator >= StepSeconds)
+	{
+		Step(static_cast<float>(StepSeconds));
+		StepAccumulator -= StepSeconds;
+	}
+
+	UpdateKinematicActors(static_cast<float>(StepAccumulator));
+}
+
+void UTrafficSimulationSubsystem::Step(const float DeltaTime)
+{
+	++NumSteps;
+	UpdateSignals(DeltaTime);
+	UpdateRouteQueries();
+	GatherViewLocations();
+	UpdateSpawning();
+	UpdateLODs(DeltaTime);
+	GatherVehicleTransforms();
+	UpdateOccupancy();
+	UpdateReservations(DeltaTime);
+	UpdateVehicles();
+	ApplyVehicleInputs();
+	MoveKinematicVehicles();
+}
+
+void UTrafficSimulationSubsystem::GatherVehicleTransforms()
+{
+	for (const int32 Index : UpdateIndices)
+	{
+		// Kinematic vehicles are placed by the simulation, their state is already up to date
+		const AWheeledVehicle* Vehicle = Vehicles[Index];
+		if (!IsValid(Vehicle) || State.KinematicFlags[Index])
+			continue;
+
+		State.Locations[Index] = Vehicle->GetActorLocation();
+		State.Forwards[Index] = Vehicle->GetActorForwardVector();
+		State.Speeds[Index] = FVector::DotProduct(Vehicle->GetVelocity(), State.Forwards[Index]);
+	}
+}
+
+void UTrafficSimulationSubsystem::UpdateOccupancy()
+{
+	const FLaneGraph& Graph = *LaneGraph;
+	for (const int32 Index : UpdateIndices)
+	{
+		// Time spent slow in front of a signal is its delay
+		UpdateSignalSubscription(Index);
+		const int32 Signal = State.Signals[Index];
+		if (Signal != INDEX_NONE && State.Speeds[Index] < SignalDelaySpeed)
+			State.SignalDelays[Index] += State.PendingDeltaTimes[Index];
+
+		const int32 TargetNode = State.TargetNodes[Index];
+		if (TargetNode == INDEX_NONE)
+		{
+			Occupancy.Remove(State.Handles[Index]);
+			continue;
+		}
+
+		State.LaneDistances[Index] = TrafficSimulation::CalculateLaneDistance(Graph, State, Index);
+		Occupancy.Update(State.Handles[Index], Graph.NodeLanes[TargetNode], State.LaneDistances[Index]);
+	}
+
+	Occupancy.SortLanes();
+}
+
+void UTrafficSimulationSubsystem::UpdateReservations(const float DeltaTime)
+{
+	// Vehicles near intersections ask every step whatever their tier, so slots are never held by vehicles waiting
+	// for their next update
+	const UTrafficSimulationSettings* Settings = GetDefault<UTrafficSimulationSettings>();
+	int32 MaxInterval = 1;
+	for (int32 Tier = 0; Settings->bEnableLOD && Tier < static_cast<int32>(ETrafficLODTier::Num); ++Tier)
+	{
+		MaxInterval = FMath::Max(MaxInterval, Settings->GetTierInterval(static_cast<ETrafficLODTier>(Tier)));
+	}
+
+	Reservations.Update(*LaneGraph, Occupancy, Signals, HandleToIndex, UpdateFlags, MaxInterval * DeltaTime, State);
+	SET_DWORD_STAT(STAT_TrafficReservationRequests, Reservations.GetNumRequests());
+}
+
+void UTrafficSimulationSubsystem::UpdateSignalSubscription(const int32 Index)
+{
+	const int32 TargetNode = State.TargetNodes[Index];
+	const int32 Signal = Signals.GetNodeSignal(TargetNode);
+	const int32 PreviousSignal = State.Signals[Index];
+	if (Signal == PreviousSignal)
+		return;
+
+	// Moving on from a signal passes it. The old subscription is dropped lazily by SetSignalStop.
+	if (PreviousSignal != INDEX_NONE)
+	{
+		++SignalMetrics.NumPassedVehicles;
+		SignalMetrics.TotalDelaySeconds += State.SignalDelays[Index];
+		State.SignalDelays[Index] = 0.0f;
+	}
+
+	State.Signals[Index] = Signal;
+	if (Signal != INDEX_NONE)
+		SignalSubscribers[Signal].AddUnique(State.Handles[Index]);
+}
+
+void UTrafficSimulationSubsystem::UpdateVehicles()
+{
+	// Traces and debug drawing need the game thread
+	const bool bObstacleTraces = CVarTrafficObstacleTraces.GetValueOnGameThread() != 0;
+	ObstacleDistances.SetNumUninitialized(State.Num(), false);
+	if (bObstacleTraces)
+	{
+		for (const int32 Index : UpdateIndices)
+		{
+			ObstacleDistances[Index] = MAX_FLT;
+			if (!HasReservation(Index))
+				CheckCollisions(Index, ObstacleDistances[Index]);
+		}
+	}
+
+	// Every vehicle only writes its own entries and reads state that does not change during the pass, so the
+	// result does not depend on the number of threads
+	const EParallelForFlags Flags =
+		CVarTrafficParallelUpdate.GetValueOnGameThread() ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread;
+	const int32 NumUpdates = UpdateIndices.Num();
+	SteeringForwardX.SetNumUninitialized(NumUpdates, false);
+	SteeringForwardY.SetNumUninitialized(NumUpdates, false);
+	SteeringToTargetX.SetNumUninitialized(NumUpdates, false);
+	SteeringToTargetY.SetNumUninitialized(NumUpdates, false);
+	SteeringToLookaheadX.SetNumUninitialized(NumUpdates, false);
+	SteeringToLookaheadY.SetNumUninitialized(NumUpdates, false);
+	SteeringOutputs.SetNumUninitialized(NumUpdates, false);
+	ArrivedFlags.SetNumUninitialized(NumUpdates, false);
+	DrivingSpeeds.SetNumUninitialized(NumUpdates, false);
+	DrivingDesiredSpeeds.SetNumUninitialized(NumUpdates, false);
+	DrivingGaps.SetNumUninitialized(NumUpdates, false);
+	DrivingApproachingRates.SetNumUninitialized(NumUpdates, false);
+	DrivingAccelerations.SetNumUninitialized(NumUpdates, false);
+	DrivingThrottle.SetNumUninitialized(NumUpdates, false);
+	DrivingBrake.SetNumUninitialized(NumUpdates, false);
+	ParallelFor(NumUpdates, [this, bObstacleTraces](const int32 UpdateIndex)
+	{
+		const int32 Index = UpdateIndices[UpdateIndex];
+		TrafficSimulation::FindLeader(*LaneGraph, Occupancy, State, Index, State.Leaders[Index], State.LeaderGaps[Index]);
+		UpdateDriving(Index, bObstacleTraces);
+		DrivingSpeeds[UpdateIndex] = State.Speeds[Index];
+		DrivingDesiredSpeeds[UpdateIndex] = State.DesiredSpeeds[Index];
+		DrivingGaps[UpdateIndex] = State.Gaps[Index];
+		DrivingApproachingRates[UpdateIndex] = State.ApproachingRates[Index];
+
+		// Gather the inputs of the steering kernel, vehicles without a target are skipped when scattering
+		const int32 TargetNode = State.TargetNodes[Index];
+		FVector ToTarget = FVector::ZeroVector;
+		FVector ToLookahead = State.Forwards[Index];
+		if (TargetNode != INDEX_NONE)
+		{
+			const float Curvature = FMath::Abs(LaneGraph->Curvatures[TargetNode]);
+			float Lookahead = State.Speeds[Index] * LookaheadTime;
+			if (Curvature > KINDA_SMALL_NUMBER)
+				Lookahead = FMath::Min(Lookahead, MaxLookaheadAngle / Curvature);
+			Lookahead = FMath::Max(Lookahead, MinLookaheadDistance);
+			ToTarget = LaneGraph->Positions[TargetNode] - State.Locations[Index];
+			ToLookahead = TrafficSimulation::CalculateLookaheadPoint(*LaneGraph, State, Index, Lookahead) -
+				State.Locations[Index];
+		}
+		SteeringForwardX[UpdateIndex] = State.Forwards[Index].X;
+		SteeringForwardY[UpdateIndex] = State.Forwards[Index].Y;
+		SteeringToTargetX[UpdateIndex] = ToTarget.X;
+		SteeringToTargetY[UpdateIndex] = ToTarget.Y;
+		SteeringToLookaheadX[UpdateIndex] = ToLookahead.X;
+		SteeringToLookaheadY[UpdateIndex] = ToLookahead.Y;
+	}, Flags);
+
+	// Pure pursuit of the lookahead point and the arrival check for four vehicles at a time
+	FTrafficSteeringKernel::CalculatePursuit(SteeringForwardX, SteeringForwardY, SteeringToLookaheadX,
+											 SteeringToLookaheadY, PursuitSteeringGain, SteeringOutputs);
+	FTrafficSteeringKernel::CalculateArrivals(SteeringForwardX, SteeringForwardY, SteeringToTargetX,
+											  SteeringToTargetY, WaypointReachedDistance, MinLookaheadDistance,
+											  ArrivedFlags);
+	// The driver model only runs for the vehicles updated this step, the others keep their inputs
+	DriverModel.CalculateAccelerations(DrivingSpeeds, DrivingDesiredSpeeds, DrivingGaps, DrivingApproachingRates,
+									   DrivingAccelerations);
+	DriverModel.CalculateInputs(DrivingAccelerations, DrivingThrottle, DrivingBrake);
+
+	for (int32 UpdateIndex = 0; UpdateIndex < NumUpdates; ++UpdateIndex)
+	{
+		const int32 Index = UpdateIndices[UpdateIndex];
+		State.Accelerations[Index] = DrivingAccelerations[UpdateIndex];
+		State.Throttle[Index] = DrivingThrottle[UpdateIndex];
+		State.Brake[Index] = DrivingBrake[UpdateIndex];
+		if (State.TargetNodes[Index] == INDEX_NONE)
+		{
+			State.Steering[Index] = 0.0f;
+			continue;
+		}
+
+		State.Steering[Index] = SteeringOutputs[UpdateIndex];
+		if (ArrivedFlags[UpdateIndex] && !State.KinematicFlags[Index])
+		{
+			TrafficSimulation::SelectNextTarget(*LaneGraph, Index, State);
+			UpdateSignalSubscription(Index);
+		}
+	}
+
+	if (CVarTrafficDebugDraw.GetValueOnGameThread())
+	{
+		for (const int32 Index : UpdateIndices)
+		{
+			DebugDrawVehicle(Index);
+		}
+	}
+}
+
+void UTrafficSimulationSubsystem::UpdateDriving(const int32 Index, const bool bObstacleTraces)
+{
+	const int32 TargetNode = State.TargetNodes[Index];
+	const bool bStopAtTarget =
+		TargetNode != INDEX_NONE && (Signals.IsNodeStop(TargetNode) || Reservations.IsStop(Index));
+	TrafficSimulation::UpdateFollowing(*LaneGraph, HandleToIndex, bStopAtTarget, Index, State);
+
+	// Obstacles that are not simulated vehicles are only known to the world. Crossing traffic at intersections is
+	// kept apart by the reservations, a trace would stop the vehicle for a car that has its own slot.
+	if (!bObstacleTraces || TargetNode == INDEX_NONE || HasReservation(Index))
+		return;
+
+	const float ObstacleGap = ObstacleDistances[Index] - 0.5f * TrafficSimulation::VehicleLength;
+	if (ObstacleGap < State.Gaps[Index])
+	{
+		State.Gaps[Index] = ObstacleGap;
+		State.ApproachingRates[Index] = State.Speeds[Index];
+	}
+}
+
+void UTrafficSimulationSubsystem::ApplyVehicleInputs()
+{
+	for (const int32 Index : UpdateIndices)
+	{
+		AWheeledVehicle* Vehicle = Vehicles[Index];
+		if (!IsValid(Vehicle) || State.KinematicFlags[Index])
+			continue;
+
+		UWheeledVehicleMovementComponent* Movement = Vehicle->GetVehicleMovement();
+		Movement->SetSteeringInput(State.Steering[Index]);
+		Movement->SetThrottleInput(State.Throttle[Index]);
+		Movement->SetBrakeInput(State.Brake[Index]);
+	}
+}
+
+void UTrafficSimulationSubsystem::GatherViewLocations()
+{
+	ViewLocations.Reset();
+	ViewDirections.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (!PlayerController)
+			continue;
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		ViewLocations.Add(ViewLocation);
+		ViewDirections.Add(ViewRotation.Vector());
+	}
+}
+
+void UTrafficSimulationSubsystem::UpdateLODs(const float DeltaTime)
+{
+	const UTrafficSimulationSettings* Settings = GetDefault<UTrafficSimulationSettings>();
+
+	int32 TierCounts[static_cast<int32>(ETrafficLODTier::Num)] = {};
+	UpdateIndices.Reset();
+	UpdateFlags.Reset();
+	UpdateFlags.SetNumZeroed(State.Num());
+	++FrameCounter;
+
+	for (int32 Index = 0; Index < State.Num(); ++Index)
+	{
+		const ETrafficLODTier CurrentTier = State.LODTiers[Index];
+		ETrafficLODTier Tier = Settings->bEnableLOD ? SelectLODTier(Index, *Settings) : ETrafficLODTier::Full;
+
+		// Vehicles owned by the simulation borrow an actor from the pool while they are not virtual and
+		// stay virtual while the pool is exhausted
+		if (State.SimulationOwnedFlags[Index])
+		{
+			const bool bHasActor = State.PoolSlots[Index] != INDEX_NONE;
+			if (Tier == ETrafficLODTier::Virtual && bHasActor)
+			{
+				ReleasePooledVehicle(Index);
+			}
+			else if (Tier != ETrafficLODTier::Virtual && !bHasActor && !AcquirePooledVehicle(Index))
+			{
+				Tier = ETrafficLODTier::Virtual;
+			}
+		}
+		++TierCounts[static_cast<int32>(Tier)];
+
+		const bool bKinematic = Tier >= ETrafficLODTier::Kinematic || !Vehicles[Index];
+		if (bKinematic != (State.KinematicFlags[Index] != 0))
+			SetVehicleKinematic(Index, bKinematic);
+
+		// Spread the updates of a tier evenly over its interval, vehicles changing tier or woken up by a signal
+		// update right away
+		State.LODTiers[Index] = Tier;
+		State.PendingDeltaTimes[Index] += DeltaTime;
+		const int32 Interval = Settings->GetTierInterval(Tier);
+		if (Tier == CurrentTier && !State.WakeFlags[Index] && (FrameCounter + State.Handles[Index]) % Interval != 0)
+			continue;
+
+		State.WakeFlags[Index] = 0;
+		UpdateIndices.Add(Index);
+		UpdateFlags[Index] = 1;
+	}
+
+	SET_DWORD_STAT(STAT_TrafficLODFullVehicles, TierCounts[static_cast<int32>(ETrafficLODTier::Full)]);
+	SET_DWORD_STAT(STAT_TrafficLODReducedVehicles, TierCounts[static_cast<int32>(ETrafficLODTier::Reduced)]);
+	SET_DWORD_STAT(STAT_TrafficLODKinematicVehicles, TierCounts[static_cast<int32>(ETrafficLODTier::Kinematic)]);
+	SET_DWORD_STAT(STAT_TrafficLODVirtualVehicles, TierCounts[static_cast<int32>(ETrafficLODTier::Virtual)]);
+	SET_DWORD_STAT(STAT_TrafficUpdatedVehicles, UpdateIndices.Num());
+	SET_DWORD_STAT(STAT_TrafficPooledVehiclesInUse, PooledVehicles.Num() - FreePoolSlots.Num());
+}
+
+ETrafficLODTier UTrafficSimulationSubsystem::SelectLODTier(const int32 Index,
+														   const UTrafficSimulationSettings& Settings) const
+{
+	float DistanceSquared = MAX_FLT;
+	for (int32 View = 0; View < ViewLocations.Num(); ++View)
+	{
+		const FVector ToVehicle = State.Locations[Index] - ViewLocations[View];
+		float ViewDistanceSquared = ToVehicle.SizeSquared();
+		if (FVector::DotProduct(ToVehicle, ViewDirections[View]) < 0.0f)
+			ViewDistanceSquared *= FMath::Square(Settings.OffscreenDistanceScale);
+
+		DistanceSquared = FMath::Min(DistanceSquared, ViewDistanceSquared);
+	}
+
+	// Moving to a coarser tier needs the distance to exceed the threshold by the hysteresis
+	const ETrafficLODTier CurrentTier = State.LODTiers[Index];
+	for (int32 TierIndex = 0; TierIndex < static_cast<int32>(ETrafficLODTier::Virtual); ++TierIndex)
+	{
+		const ETrafficLODTier Tier = static_cast<ETrafficLODTier>(TierIndex);
+		const float Hysteresis = Tier >= CurrentTier ? 1.0f + Settings.TierHysteresis : 1.0f;
+		if (DistanceSquared < FMath::Square(Settings.GetTierDistance(Tier) * Hysteresis))
+			return Tier;
+	}
+
+	return ETrafficLODTier::Virtual;
+}
+
+void UTrafficSimulationSubsystem::SetVehicleKinematic(const int32 Index, const bool bKinematic)
+{
+	State.KinematicFlags[Index] = bKinematic ? 1 : 0;
+
+	AWheeledVehicle* Vehicle = Vehicles[Index];
+	if (!IsValid(Vehicle))
+		return;
+
+	USkeletalMeshComponent* Mesh = Vehicle->GetMesh();
+	UWheeledVehicleMovementComponent* Movement = Vehicle->GetVehicleMovement();
+	if (bKinematic)
+	{
+		State.Locations[Index] = Vehicle->GetActorLocation();
+		State.PreviousLocations[Index] = State.Locations[Index];
+		State.InterpolationTimes[Index] = 0.0f;
+
+		// Keep the height of the actor above the lane so placing it on the graph does not sink it into the road
+		const int32 TargetNode = State.TargetNodes[Index];
+		State.HeightOffsets[Index] =
+			TargetNode != INDEX_NONE ? State.Locations[Index].Z - LaneGraph->Positions[TargetNode].Z : 0.0f;
+		State.Speeds[Index] = FMath::Max(State.Speeds[Index], 0.0f);
+
+		Movement->SetThrottleInput(0.0f);
+		Movement->SetBrakeInput(0.0f);
+		Movement->Deactivate();
+		Mesh->SetSimulatePhysics(false);
+	}
+	else
+	{
+		// Hand over the kinematic speed so the vehicle continues without a jerk
+		Mesh->SetSimulatePhysics(true);
+		Mesh->SetPhysicsLinearVelocity(State.Forwards[Index] * State.Speeds[Index]);
+		Movement->Activate();
+	}
+}
+
+void UTrafficSimulationSubsystem::MoveKinematicVehicles()
+{
+	const FLaneGraph& Graph = *LaneGraph;
+	for (const int32 Index : UpdateIndices)
+	{
+		// Vehicles in coarse tiers catch up on all the time since their last update
+		const float DeltaTime = State.PendingDeltaTimes[Index];
+		State.PendingDeltaTimes[Index] = 0.0f;
+
+		if (!State.KinematicFlags[Index])
+			continue;
+
+		// The new move starts where the actor is drawn, vehicles woken up early have not finished the last one
+		State.PreviousLocations[Index] = CalculateKinematicLocation(Index, DeltaTime);
+		State.InterpolationTimes[Index] = DeltaTime;
+
+		const float Speed = FMath::Max(State.Speeds[Index] + State.Accelerations[Index] * DeltaTime, 0.0f);
+		State.Speeds[Index] = Speed;
+
+		// Advance along the lane polyline, the height above the graph is kept
+		const FVector HeightOffset(0.0f, 0.0f, State.HeightOffsets[Index]);
+		State.Locations[Index] -= HeightOffset;
+		TrafficSimulation::MoveAlongGraph(Graph, Index, Speed * DeltaTime, State);
+		State.Locations[Index] += HeightOffset;
+
+		// Signals ahead are subscribed to right away, the vehicle may not be updated again before they change
+		UpdateSignalSubscription(Index);
+	}
+}
+
+FVector UTrafficSimulationSubsystem::CalculateKinematicLocation(const int32 Index, const float DrawTime) const
+{
+	const float InterpolationTime = State.InterpolationTimes[Index];
+	const float Alpha = InterpolationTime > 0.0f ? FMath::Min(DrawTime / InterpolationTime, 1.0f) : 1.0f;
+	return FMath::Lerp(State.PreviousLocations[Index], State.Locations[Index], Alpha);
+}
+
+void UTrafficSimulationSubsystem::UpdateKinematicActors(const float StepTime)
+{
+	for (int32 Index = 0; Index < State.Num(); ++Index)
+	{
+		// Virtual vehicles only exist in the state
+		AWheeledVehicle* Vehicle = Vehicles[Index];
+		if (!State.KinematicFlags[Index] || !IsValid(Vehicle))
+			continue;
+
+		// The move of the last update is drawn over the steps until the next one
+		const FVector Location = CalculateKinematicLocation(Index, State.PendingDeltaTimes[Index] + StepTime);
+		Vehicle->SetActorLocationAndRotation(Location, State.Forwards[Index].Rotation(), false, nullptr,
+											 ETeleportType::TeleportPhysics);
+	}
+}
+
+void UTrafficSimulationSubsystem::UpdateSpawning()
+{
+	const UTrafficSimulationSettings* Settings = GetDefault<UTrafficSimulationSettings>();
+
+	// Vehicles of the spawner leave the network at sinks. Despawns are budgeted as well, the rest waits at the
+	// sink for the next frame. Iterating backwards keeps unvisited vehicles in place when removing by swap.
+	int32 NumDespawns = 0;
+	for (int32 Index = State.Num() - 1; Index >= 0 && NumDespawns < Settings->MaxDespawnsPerFrame; --Index)
+	{
+		if (State.SimulationOwnedFlags[Index] && State.TargetNodes[Index] == INDEX_NONE)
+		{
+			UnregisterVehicle(State.Handles[Index]);
+			++NumDespawns;
+		}
+	}
+	SET_DWORD_STAT(STAT_TrafficDespawnedVehicles, NumDespawns);
+
+	const FLaneGraph& Graph = *LaneGraph;
+	const int32 NumLanes = Graph.GetNumLanes();
+	if (!Settings->bEnableSpawning || NumLanes == 0)
+	{
+		SET_DWORD_STAT(STAT_TrafficSpawnedVehicles, 0);
+		return;
+	}
+
+	// Check a window of lanes per frame and cycle through all of them over time
+	int32 NumSpawns = 0;
+	const int32 NumLanesToCheck = FMath::Min(Settings->MaxSpawnLanesPerFrame, NumLanes);
+	for (int32 Check = 0; Check < NumLanesToCheck && NumSpawns < Settings->MaxSpawnsPerFrame; ++Check)
+	{
+		const int32 Lane = SpawnLaneCursor;
+		SpawnLaneCursor = (SpawnLaneCursor + 1) % NumLanes;
+
+		const TArrayView<const FLaneOccupant> Occupants = Occupancy.GetOccupants(Lane);
+		if (Graph.LaneNumNodes[Lane] == 0 || Occupants.Num() >= LaneTargetVehicleCounts[Lane])
+			continue;
+
+		// The start of the lane has to be free
+		if (Occupants.Num() > 0 && Occupants[0].Distance < Settings->SpawnClearance)
+			continue;
+
+		// Entry points of the network are where traffic comes from, other lanes are only filled out of sight
+		const int32 EntryNode = Graph.LaneFirstNodes[Lane];
+		if (Graph.GetInEdges(EntryNode).Num() > 0 && IsNearViewLocation(Graph.Positions[EntryNode],
+																		 Settings->HiddenSpawnDistance))
+			continue;
+
+		const int32 Handle = AddVirtualVehicle(EntryNode);
+		if (Handle == INDEX_NONE)
+			continue;
+
+		Occupancy.Update(Handle, Lane, 0.0f);
+		++NumSpawns;
+	}
+
+	SET_DWORD_STAT(STAT_TrafficSpawnedVehicles, NumSpawns);
+}
+
+bool UTrafficSimulationSubsystem::IsNearViewLocation(const FVector& Location, const float Radius) const
+{
+	for (const FVector& ViewLocation : ViewLocations)
+	{
+		if (FVector::DistSquared(ViewLocation, Location) < FMath::Square(Radius))
+			return true;
+	}
+
+	return false;
+}
+
+void UTrafficSimulationSubsystem::CreateVehiclePool()
+{
+	const UTrafficSimulationSettings* Settings = GetDefault<UTrafficSimulationSettings>();
+	if (Settings->PooledVehicleClass.IsNull() || Settings->VehiclePoolSize <= 0)
+		return;
+
+	// All actors are spawned up front so promoting a virtual vehicle never spawns or destroys anything
+	for (int32 Slot = 0; Slot < Settings->VehiclePoolSize; ++Slot)
+	{
+		PooledVehicles.Add(nullptr);
+		PooledControllers.Add(nullptr);
+		if (!SpawnPooledVehicle(Slot))
+		{
+			PooledVehicles.Pop(false);
+			PooledControllers.Pop(false);
+			break;
+		}
+
+		FreePoolSlots.Add(Slot);
+	}
+}
+
+bool UTrafficSimulationSubsystem::SpawnPooledVehicle(const int32 Slot)
+{
+	const UTrafficSimulationSettings* Settings = GetDefault<UTrafficSimulationSettings>();
+	UClass* VehicleClass = Settings->PooledVehicleClass.LoadSynchronous();
+	UClass* ControllerClass = Settings->PooledControllerClass.LoadSynchronous();
+	if (!VehicleClass)
+		return false;
+
+	if (!ControllerClass)
+		ControllerClass = ACarController::StaticClass();
+
+	UWorld* World = GetWorld();
+	const FTransform ParkingTransform(FVector(0.0f, 0.0f, World->GetWorldSettings()->KillZ + PoolParkingHeight));
+	AWheeledVehicle* Vehicle = World->SpawnActorDeferred<AWheeledVehicle>(
+		VehicleClass, ParkingTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (!Vehicle)
+		return false;
+
+	Vehicle->AutoPossessAI = EAutoPossessAI::Disabled;
+	Vehicle->FinishSpawning(ParkingTransform);
+	Vehicle->SetActorHiddenInGame(true);
+	Vehicle->SetActorEnableCollision(false);
+	Vehicle->GetMesh()->SetSimulatePhysics(false);
+	Vehicle->GetVehicleMovement()->Deactivate();
+
+	ACarController* Controller = World->SpawnActorDeferred<ACarController>(
+		ControllerClass, FTransform::Identity, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (!Controller)
+	{
+		Vehicle->Destroy();
+		return false;
+	}
+
+	Controller->bRegisterWithSimulation = false;
+	Controller->FinishSpawning(FTransform::Identity);
+	Controller->Possess(Vehicle);
+
+	PooledVehicles[Slot] = Vehicle;
+	PooledControllers[Slot] = Controller;
+	return true;
+}
+
+bool UTrafficSimulationSubsystem::AcquirePooledVehicle(const int32 Index)
+{
+	while (FreePoolSlots.Num() > 0)
+	{
+		const int32 Slot = FreePoolSlots.Pop(false);
+		if (!IsValid(PooledVehicles[Slot]) || !IsValid(PooledControllers[Slot]))
+		{
+			// Pool actors destroyed from the outside are replaced, the slot is dropped if that fails
+			if (IsValid(PooledVehicles[Slot]))
+				PooledVehicles[Slot]->Destroy();
+			if (IsValid(PooledControllers[Slot]))
+				PooledControllers[Slot]->Destroy();
+			PooledVehicles[Slot] = nullptr;
+			PooledControllers[Slot] = nullptr;
+
+			if (!SpawnPooledVehicle(Slot))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Could not replace destroyed pooled vehicle %d"), Slot);
+				continue;
+			}
+		}
+
+		// Pooled actors are parked kinematic, the LOD update switches them to physics if needed
+		AWheeledVehicle* Vehicle = PooledVehicles[Slot];
+		ACarController* Controller = PooledControllers[Slot];
+		Vehicle->SetActorLocationAndRotation(State.Locations[Index], State.Forwards[Index].Rotation(), false, nullptr,
+											 ETeleportType::TeleportPhysics);
+		Vehicle->SetActorHiddenInGame(false);
+		Vehicle->SetActorEnableCollision(true);
+		Controller->AssignSimulationHandle(State.Handles[Index]);
+
+		Vehicles[Index] = Vehicle;
+		Controllers[Index] = Controller;
+		State.PoolSlots[Index] = Slot;
+		State.KinematicFlags[Index] = 1;
+		return true;
+	}
+
+	return false;
+}
+
+void UTrafficSimulationSubsystem::ReleasePooledVehicle(const int32 Index)
+{
+	const int32 Slot = State.PoolSlots[Index];
+	if (!State.KinematicFlags[Index])
+		SetVehicleKinematic(Index, true);
+
+	AWheeledVehicle* Vehicle = PooledVehicles[Slot];
+	if (IsValid(Vehicle))
+	{
+		Vehicle->SetActorHiddenInGame(true);
+		Vehicle->SetActorEnableCollision(false);
+	}
+
+	ACarController* Controller = PooledControllers[Slot];
+	if (IsValid(Controller))
+		Controller->AssignSimulationHandle(INDEX_NONE);
+
+	Vehicles[Index] = nullptr;
+	Controllers[Index] = nullptr;
+	State.PoolSlots[Index] = INDEX_NONE;
+	FreePoolSlots.Add(Slot);
+}
+
+bool UTrafficSimulationSubsystem::HasReservation(const int32 Index) const
+{
+	return Reservations.HasReservation(State.Handles[Index]);
+}
+
+bool UTrafficSimulationSubsystem::CheckCollisions(const int32 Index, float& OutDistance) const
+{
+	OutDistance = MAX_FLT;
+
+	const AWheeledVehicle* Vehicle = Vehicles[Index];
+	if (!IsValid(Vehicle))
+		return false;
+
+	FHitResult HitResult;
+	FCollisionQueryParams QueryParams;
+	QueryParams.AddIgnoredActor(Vehicle);
+	FVector Start = State.Locations[Index];
+	Start.Z += CollisionTraceHeight;
+	const FVector End = Start + (State.Forwards[Index] * CollisionTraceDistance);
+
+	if (CVarTrafficDebugDraw.GetValueOnGameThread())
+	{
+		DrawDebugLine(GetWorld(), Start, End, FColor::Magenta);
+	}
+
+	if (!GetWorld()->LineTraceSingleByChannel(HitResult, Start, End, ECollisionChannel::ECC_Visibility, QueryParams))
+		return false;
+
+	OutDistance = HitResult.Distance;
+	return true;
+}
+
+void UTrafficSimulationSubsystem::DebugDrawVehicle(const int32 Index) const
+{
+	const int32 TargetNode = State.TargetNodes[Index];
+	if (TargetNode == INDEX_NONE)
+		return;
+
+	const FVector& TargetLocation = LaneGraph->Positions[TargetNode];
+
+	FVector DebugVehicleLocation = State.Locations[Index];
+	DebugVehicleLocation.Z += 10.f;
+	DrawDebugLine(GetWorld(), DebugVehicleLocation, DebugVehicleLocation + State.Forwards[Index] * 500.0f, FColor::Red);
+	DrawDebugLine(GetWorld(), DebugVehicleLocation, TargetLocation, FColor::Blue);
+}
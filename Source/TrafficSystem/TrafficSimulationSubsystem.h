@@ -0,0 +1,258 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "IntelligentDriverModel.h"
+#include "LaneGraph.h"
+#include "LaneLandmarks.h"
+#include "LaneOccupancy.h"
+#include "LaneRoutePlanner.h"
+#include "LaneRouteQueryQueue.h"
+#include "LaneSpatialIndex.h"
+#include "TrafficReservationPass.h"
+#include "TrafficSignalScheduler.h"
+#include "TrafficSignalTable.h"
+#include "TrafficVehicleState.h"
+#include "TrafficSimulationSubsystem.generated.h"
+
+class ACarController;
+class ALane;
+class ATrafficCorridor;
+class ATrafficLight;
+class AWheeledVehicle;
+class UTrafficSimulationSettings;
+
+/**
+ * Updates all registered cars in one batched pass per frame. The subsystem owns the driving state,
+ * ACarController only registers its vehicle and keeps the returned handle.
+ */
+UCLASS()
+class TRAFFICSYSTEM_API UTrafficSimulationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// UWorldSubsystem
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+
+	// UTrafficSimulationSubsystem
+	int32 RegisterVehicle(ACarController* Controller, AWheeledVehicle* Vehicle, ALane* Lane, int32 WaypointIndex);
+	void UnregisterVehicle(int32 Handle);
+
+	// Adds a vehicle without an actor on StartNode. It borrows a pooled actor while it is near a view point
+	// and is removed with UnregisterVehicle.
+	int32 AddVirtualVehicle(int32 StartNode);
+	bool IsValidHandle(int32 Handle) const;
+
+	int32 GetNumVehicles() const;
+	const FTrafficVehicleState& GetVehicleState() const;
+
+	// Lane graph baked from all ALane actors at BeginPlay
+	const FLaneGraph& GetLaneGraph() const;
+	bool HasLaneGraph() const;
+	const FLaneSpatialIndex& GetSpatialIndex() const;
+	int32 GetLaneIndex(const ALane* Lane) const;
+	ALane* GetLaneActor(int32 LaneIndex) const;
+	int32 FindNode(const ALane* Lane, int32 WaypointId) const;
+
+	// Plans a route on the game thread, using the landmark tables of the level if they match the lane graph
+	bool FindRoute(int32 StartNode, int32 GoalNode, TArray<int32>& OutRoute);
+
+	// Queues a route query from the vehicle's current target to the lane graph location closest to Destination.
+	// The route is planned on worker threads and picked up by the vehicle a few frames later.
+	bool SetVehicleDestination(int32 Handle, const FVector& Destination);
+	const FLaneRouteQueryStats& GetRouteQueryStats() const;
+
+	// Runtime stop state of a node, initialized from FWaypoint::Stop. Nodes governed by a signal also stop
+	// while the signal does.
+	void SetNodeStop(int32 Node, bool bStopFlag);
+	bool IsNodeStop(int32 Node) const;
+
+	// Signals store the stop state of a traffic light once for all nodes it governs, so switching one is a
+	// single write. Vehicles approaching a governed node subscribe to its signal and are woken up on changes
+	// instead of waiting for the next update of their LOD tier.
+	int32 AddSignal(TArrayView<const int32> Nodes, bool bStopFlag);
+	void SetSignalStop(int32 Signal, bool bStopFlag);
+	bool IsSignalStop(int32 Signal) const;
+	int32 GetNumSignals() const;
+
+	// Phase plans of all traffic light controllers, advanced with the simulation time
+	const FTrafficSignalScheduler& GetSignalScheduler() const;
+	double GetSimulationTime() const;
+
+	// Steps done since BeginPlay, see UTrafficSimulationSettings::FixedStepRate
+	int64 GetNumSteps() const;
+
+	// Throughput and delay at all signals since the start or the last reset, to compare signal timings
+	const FTrafficSignalMetrics& GetSignalMetrics() const;
+	void ResetSignalMetrics();
+
+protected:
+	int32 AllocateHandle();
+
+	// One update of signals, spawning and all vehicles due in their LOD tier
+	void Step(float DeltaTime);
+
+	void BuildLaneGraph();
+	void LoadLandmarks();
+	void ResolveTrafficLights();
+	void ResolveSignalPlans();
+
+	// Adjusts the phases of a controller on a green wave corridor to the common cycle and returns when its plan
+	// has to start
+	double CalculateCoordinatedStartTime(const ATrafficCorridor& Corridor, int32 IntersectionIndex,
+										 TArray<FTrafficSignalPhase>& Phases) const;
+	void UpdateSignals(float DeltaTime);
+
+	void SubmitRouteQuery(int32 Index, int32 GoalNode);
+	void UpdateRouteQueries();
+
+	void GatherVehicleTransforms();
+	void UpdateOccupancy();
+
+	// Subscribes the vehicle to the signal of its target, called whenever the target may have changed
+	void UpdateSignalSubscription(int32 Index);
+
+	// Grants slots at the conflict points of intersections, vehicles without one stop in front of the intersection
+	void UpdateReservations(float DeltaTime);
+	bool HasReservation(int32 Index) const;
+
+	// Decides the inputs of all vehicles updated this step. The per-vehicle steps run in parallel and only
+	// write the entries of their own vehicle; everything touching actors happens on the game thread.
+	void UpdateVehicles();
+	void UpdateDriving(int32 Index, bool bObstacleTraces);
+	void ApplyVehicleInputs();
+
+	void GatherViewLocations();
+
+	// Assigns LOD tiers and collects the vehicles updated this step. Vehicles in the kinematic tiers are moved
+	// along the lane graph with their transform set directly, which skips the vehicle physics entirely.
+	void UpdateLODs(float DeltaTime);
+	ETrafficLODTier SelectLODTier(int32 Index, const UTrafficSimulationSettings& Settings) const;
+	void SetVehicleKinematic(int32 Index, bool bKinematic);
+	void MoveKinematicVehicles();
+
+	// Places the actors of kinematic vehicles between their locations before and after their last move, StepTime
+	// after the start of the last step
+	void UpdateKinematicActors(float StepTime);
+	FVector CalculateKinematicLocation(int32 Index, float DrawTime) const;
+
+	// Fills lanes below their target vehicle count with virtual vehicles and removes them at sinks, both within
+	// a per-frame budget
+	void UpdateSpawning();
+	bool IsNearViewLocation(const FVector& Location, float Radius) const;
+
+	void CreateVehiclePool();
+
+	// Spawns the parked actors of a pool slot, also used to replace actors destroyed while the slot was free
+	bool SpawnPooledVehicle(int32 Slot);
+	bool AcquirePooledVehicle(int32 Index);
+	void ReleasePooledVehicle(int32 Index);
+
+	// Trace for obstacles that are not in the lane occupancy, only used with Traffic.ObstacleTraces
+	bool CheckCollisions(int32 Index, float& OutDistance) const;
+	void DebugDrawVehicle(int32 Index) const;
+
+	TSharedPtr<const FLaneGraph, ESPMode::ThreadSafe> LaneGraph;
+	TSharedPtr<const FLaneLandmarks, ESPMode::ThreadSafe> Landmarks;
+	FLaneSpatialIndex SpatialIndex;
+	FLaneRoutePlanner RoutePlanner;
+	FLaneOccupancy Occupancy;
+	FTrafficReservationPass Reservations;
+
+	// Stop state of the nodes and signals, the handles of the vehicles subscribed to every signal and its light.
+	// Subscriber lists may hold stale handles, they are dropped when the signal changes.
+	FTrafficSignalTable Signals;
+	TArray<TArray<int32>> SignalSubscribers;
+	TArray<TWeakObjectPtr<ATrafficLight>> SignalLights;
+	FTrafficSignalMetrics SignalMetrics;
+
+	FTrafficSignalScheduler SignalScheduler;
+	TArray<FTrafficSignalChange> SignalChanges;
+	double SimulationTime = 0.0;
+	int64 NumSteps = 0;
+
+	// Frame time not simulated yet, less than one fixed step
+	double StepAccumulator = 0.0;
+	bool bLaneGraphBuilt = false;
+
+	// Lane actors in lane graph order, only used to translate actor references into node indices
+	TArray<TWeakObjectPtr<ALane>> LaneActors;
+	TMap<const ALane*, int32> LaneIndices;
+
+	// Route queries running on worker threads, results are matched to vehicles by ticket
+	FLaneRouteQueryQueue RouteQueries;
+	TArray<FLaneRouteQueryResult> RouteQueryResults;
+	TMap<int32, int32> PendingRouteHandles;
+
+	FTrafficVehicleState State;
+	FIntelligentDriverModel DriverModel;
+	TArray<FVector> ViewLocations;
+	TArray<FVector> ViewDirections;
+
+	// Vehicles updated in the current step, also flagged indexed like State, and the step number used to stagger
+	// them
+	TArray<int32> UpdateIndices;
+	TArray<uint8> UpdateFlags;
+	uint32 FrameCounter = 0;
+
+	// Results of the obstacle traces of the current step, indexed like State
+	TArray<float> ObstacleDistances;
+
+	// Inputs and outputs of the steering kernel, indexed like UpdateIndices
+	TArray<float> SteeringForwardX;
+	TArray<float> SteeringForwardY;
+	TArray<float> SteeringToTargetX;
+	TArray<float> SteeringToTargetY;
+	TArray<float> SteeringToLookaheadX;
+	TArray<float> SteeringToLookaheadY;
+	TArray<float> SteeringOutputs;
+	TArray<uint8> ArrivedFlags;
+
+	// Inputs and outputs of the driver model, indexed like UpdateIndices
+	TArray<float> DrivingSpeeds;
+	TArray<float> DrivingDesiredSpeeds;
+	TArray<float> DrivingGaps;
+	TArray<float> DrivingApproachingRates;
+	TArray<float> DrivingAccelerations;
+	TArray<float> DrivingThrottle;
+	TArray<float> DrivingBrake;
+
+	// Actors aligned with the entries in State
+	UPROPERTY(Transient)
+	TArray<AWheeledVehicle*> Vehicles;
+
+	UPROPERTY(Transient)
+	TArray<ACarController*> Controllers;
+
+	// Actors spawned at BeginPlay and lent to virtual vehicles, aligned by pool slot
+	UPROPERTY(Transient)
+	TArray<AWheeledVehicle*> PooledVehicles;
+
+	UPROPERTY(Transient)
+	TArray<ACarController*> PooledControllers;
+
+	TArray<int32> FreePoolSlots;
+
+	// Spawner state
+	TArray<int32> LaneTargetVehicleCounts;
+	int32 SpawnLaneCursor = 0;
+
+	// Maps a stable handle to the current index into State, INDEX_NONE for released handles
+	TArray<int32> HandleToIndex;
+	TArray<int32> FreeHandles;
+};
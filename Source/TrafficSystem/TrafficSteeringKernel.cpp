@@ -0,0 +1,376 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficSteeringKernel.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+namespace
+{
+	// tan(1 degree), targets closer to the heading than this are steered at straight
+	constexpr float StraightTolerance = 0.01745506f;
+
+	// Keeps the pursuit curvature finite for lookahead points on top of the vehicle
+	constexpr float MinLookaheadDistanceSquared = 1.0f;
+
+	void CheckInputs(const TArrayView<const float> ForwardX, const TArrayView<const float> ForwardY,
+					 const TArrayView<const float> ToTargetX, const TArrayView<const float> ToTargetY,
+					 const TArrayView<float> OutSteering, const TArrayView<uint8> OutArrived)
+	{
+		check(ForwardX.Num() == OutSteering.Num() && ForwardY.Num() == OutSteering.Num());
+		check(ToTargetX.Num() == OutSteering.Num() && ToTargetY.Num() == OutSteering.Num());
+		check(OutArrived.Num() == OutSteering.Num());
+	}
+}
+
+void FTrafficSteeringKernel::Calculate(const TArrayView<const float> ForwardX, const TArrayView<const float> ForwardY,
+									   const TArrayView<const float> ToTargetX, const TArrayView<const float> ToTargetY,
+									   const float ArrivalDistance, TArrayView<float> OutSteering,
+									   TArrayView<uint8> OutArrived)
+{
+	CheckInputs(ForwardX, ForwardY, ToTargetX, ToTargetY, OutSteering, OutArrived);
+
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister One = VectorOne();
+	const VectorRegister Half = VectorSetFloat1(0.5f);
+	const VectorRegister MinusHalf = VectorSetFloat1(-0.5f);
+	const VectorRegister Tolerance = VectorSetFloat1(StraightTolerance);
+	const VectorRegister ArrivalDistanceSquared = VectorSetFloat1(ArrivalDistance * ArrivalDistance);
+
+	const int32 NumVectorized = OutSteering.Num() & ~3;
+	for (int32 Index = 0; Index < NumVectorized; Index += 4)
+	{
+		const VectorRegister Fx = VectorLoad(&ForwardX[Index]);
+		const VectorRegister Fy = VectorLoad(&ForwardY[Index]);
+		const VectorRegister Tx = VectorLoad(&ToTargetX[Index]);
+		const VectorRegister Ty = VectorLoad(&ToTargetY[Index]);
+
+		// Same operation order as the scalar path so both agree exactly
+		const VectorRegister Cross = VectorSubtract(VectorMultiply(Fx, Ty), VectorMultiply(Fy, Tx));
+		const VectorRegister Dot = VectorAdd(VectorMultiply(Fx, Tx), VectorMultiply(Fy, Ty));
+
+		const VectorRegister RightMask = VectorCompareGT(Cross, Zero);
+		const VectorRegister StraightMask = VectorBitwiseAnd(
+			VectorCompareGT(Dot, Zero), VectorCompareGT(VectorMultiply(Tolerance, Dot), VectorAbs(Cross)));
+		const VectorRegister FullMask = VectorBitwiseAnd(RightMask, VectorCompareGE(Cross, Dot));
+
+		VectorRegister Steering = VectorSelect(RightMask, Half, MinusHalf);
+		Steering = VectorSelect(FullMask, One, Steering);
+		Steering = VectorSelect(StraightMask, Zero, Steering);
+		VectorStore(Steering, &OutSteering[Index]);
+
+		const VectorRegister DistanceSquared = VectorAdd(VectorMultiply(Tx, Tx), VectorMultiply(Ty, Ty));
+		const int32 ArrivedBits = VectorMaskBits(VectorCompareGE(ArrivalDistanceSquared, DistanceSquared));
+		OutArrived[Index] = ArrivedBits & 1;
+		OutArrived[Index + 1] = (ArrivedBits >> 1) & 1;
+		OutArrived[Index + 2] = (ArrivedBits >> 2) & 1;
+		OutArrived[Index + 3] = (ArrivedBits >> 3) & 1;
+	}
+
+	const int32 NumRemaining = OutSteering.Num() - NumVectorized;
+	if (NumRemaining > 0)
+	{
+		CalculateScalar(ForwardX.Slice(NumVectorized, NumRemaining), ForwardY.Slice(NumVectorized, NumRemaining),
+						ToTargetX.Slice(NumVectorized, NumRemaining), ToTargetY.Slice(NumVectorized, NumRemaining),
+						ArrivalDistance, OutSteering.Slice(NumVectorized, NumRemaining),
+						OutArrived.Slice(NumVectorized, NumRemaining));
+	}
+}
+
+void FTrafficSteeringKernel::CalculateScalar(const TArrayView<const float> ForwardX,
+											 const TArrayView<const float> ForwardY,
+											 const TArrayView<const float> ToTargetX,
+											 const TArrayView<const float> ToTargetY, const float ArrivalDistance,
+											 TArrayView<float> OutSteering, TArrayView<uint8> OutArrived)
+{
+	CheckInputs(ForwardX, ForwardY, ToTargetX, ToTargetY, OutSteering, OutArrived);
+
+	const float ArrivalDistanceSquared = ArrivalDistance * ArrivalDistance;
+	for (int32 Index = 0; Index < OutSteering.Num(); ++Index)
+	{
+		const float Tx = ToTargetX[Index];
+		const float Ty = ToTargetY[Index];
+		OutSteering[Index] = CalculateSteering(ForwardX[Index], ForwardY[Index], Tx, Ty);
+		OutArrived[Index] = ArrivalDistanceSquared >= Tx * Tx + Ty * Ty;
+	}
+}
+
+float FTrafficSteeringKernel::CalculateSteering(const float ForwardX, const float ForwardY, const float ToTargetX,
+												const float ToTargetY)
+{
+	// The cross product is positive for targets on the right, both together give the heading error without
+	// normalizing. The buckets match CalculateTurnAngle: straight within 1 degree, full lock only for right turns
+	// of 45 degrees and more, half lock otherwise.
+	const float Cross = ForwardX * ToTargetY - ForwardY * ToTargetX;
+	const float Dot = ForwardX * ToTargetX + ForwardY * ToTargetY;
+	if (Dot > 0.0f && StraightTolerance * Dot > FMath::Abs(Cross))
+		return 0.0f;
+
+	if (Cross > 0.0f && Cross >= Dot)
+		return 1.0f;
+
+	return Cross > 0.0f ? 0.5f : -0.5f;
+}
+
+void FTrafficSteeringKernel::CalculatePursuit(const TArrayView<const float> ForwardX,
+											  const TArrayView<const float> ForwardY,
+											  const TArrayView<const float> ToLookaheadX,
+											  const TArrayView<const float> ToLookaheadY, const float SteeringGain,
+											  TArrayView<float> OutSteering)
+{
+	check(ForwardX.Num() == OutSteering.Num() && ForwardY.Num() == OutSteering.Num());
+	check(ToLookaheadX.Num() == OutSteering.Num() && ToLookaheadY.Num() == OutSteering.Num());
+
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister One = VectorOne();
+	const VectorRegister MinusOne = VectorSetFloat1(-1.0f);
+	const VectorRegister Gain = VectorSetFloat1(SteeringGain);
+	const VectorRegister MinDistanceSquared = VectorSetFloat1(MinLookaheadDistanceSquared);
+
+	const int32 NumVectorized = OutSteering.Num() & ~3;
+	for (int32 Index = 0; Index < NumVectorized; Index += 4)
+	{
+		const VectorRegister Fx = VectorLoad(&ForwardX[Index]);
+		const VectorRegister Fy = VectorLoad(&ForwardY[Index]);
+		const VectorRegister Lx = VectorLoad(&ToLookaheadX[Index]);
+		const VectorRegister Ly = VectorLoad(&ToLookaheadY[Index]);
+
+		const VectorRegister Cross = VectorSubtract(VectorMultiply(Fx, Ly), VectorMultiply(Fy, Lx));
+		const VectorRegister Dot = VectorAdd(VectorMultiply(Fx, Lx), VectorMultiply(Fy, Ly));
+		const VectorRegister DistanceSquared = VectorAdd(VectorMultiply(Lx, Lx), VectorMultiply(Ly, Ly));
+
+		VectorRegister Steering =
+			VectorDivide(VectorMultiply(Gain, Cross), VectorMax(DistanceSquared, MinDistanceSquared));
+		Steering = VectorMin(VectorMax(Steering, MinusOne), One);
+
+		const VectorRegister BehindMask = VectorCompareGE(Zero, Dot);
+		const VectorRegister FullLock = VectorSelect(VectorCompareGE(Cross, Zero), One, MinusOne);
+		VectorStore(VectorSelect(BehindMask, FullLock, Steering), &OutSteering[Index]);
+	}
+
+	for (int32 Index = NumVectorized; Index < OutSteering.Num(); ++Index)
+	{
+		OutSteering[Index] = CalculatePursuitSteering(ForwardX[Index], ForwardY[Index], ToLookaheadX[Index],
+													  ToLookaheadY[Index], SteeringGain);
+	}
+}
+
+float FTrafficSteeringKernel::CalculatePursuitSteering(const float ForwardX, const float ForwardY,
+													   const float ToLookaheadX, const float ToLookaheadY,
+													   const float SteeringGain)
+{
+	// Same operation order as the vectorized path
+	const float Cross = ForwardX * ToLookaheadY - ForwardY * ToLookaheadX;
+	const float Dot = ForwardX * ToLookaheadX + ForwardY * ToLookaheadY;
+	if (Dot <= 0.0f)
+		return Cross >= 0.0f ? 1.0f : -1.0f;
+
+	const float DistanceSquared = ToLookaheadX * ToLookaheadX + ToLookaheadY * ToLookaheadY;
+	const float Steering = SteeringGain * Cross / FMath::Max(DistanceSquared, MinLookaheadDistanceSquared);
+	return FMath::Min(FMath::Max(Steering, -1.0f), 1.0f);
+}
+
+void FTrafficSteeringKernel::CalculateArrivals(const TArrayView<const float> ForwardX,
+											   const TArrayView<const float> ForwardY,
+											   const TArrayView<const float> ToTargetX,
+											   const TArrayView<const float> ToTargetY, const float ArrivalDistance,
+											   const float PassDistance, TArrayView<uint8> OutArrived)
+{
+	check(ForwardX.Num() == OutArrived.Num() && ForwardY.Num() == OutArrived.Num());
+	check(ToTargetX.Num() == OutArrived.Num() && ToTargetY.Num() == OutArrived.Num());
+
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister ArrivalDistanceSquared = VectorSetFloat1(ArrivalDistance * ArrivalDistance);
+	const VectorRegister PassDistanceSquared = VectorSetFloat1(PassDistance * PassDistance);
+
+	const int32 NumVectorized = OutArrived.Num() & ~3;
+	for (int32 Index = 0; Index < NumVectorized; Index += 4)
+	{
+		const VectorRegister Fx = VectorLoad(&ForwardX[Index]);
+		const VectorRegister Fy = VectorLoad(&ForwardY[Index]);
+		const VectorRegister Tx = VectorLoad(&ToTargetX[Index]);
+		const VectorRegister Ty = VectorLoad(&ToTargetY[Index]);
+
+		const VectorRegister Dot = VectorAdd(VectorMultiply(Fx, Tx), VectorMultiply(Fy, Ty));
+		const VectorRegister DistanceSquared = VectorAdd(VectorMultiply(Tx, Tx), VectorMultiply(Ty, Ty));
+		const VectorRegister PassedMask =
+			VectorBitwiseAnd(VectorCompareGE(Zero, Dot), VectorCompareGE(PassDistanceSquared, DistanceSquared));
+		const int32 ArrivedBits = VectorMaskBits(
+			VectorBitwiseOr(VectorCompareGE(ArrivalDistanceSquared, DistanceSquared), PassedMask));
+		OutArrived[Index] = ArrivedBits & 1;
+		OutArrived[Index + 1] = (ArrivedBits >> 1) & 1;
+		OutArrived[Index + 2] = (ArrivedBits >> 2) & 1;
+		OutArrived[Index + 3] = (ArrivedBits >> 3) & 1;
+	}
+
+	const float ArrivalDistanceSquaredScalar = ArrivalDistance * ArrivalDistance;
+	const float PassDistanceSquaredScalar = PassDistance * PassDistance;
+	for (int32 Index = NumVectorized; Index < OutArrived.Num(); ++Index)
+	{
+		const float Tx = ToTargetX[Index];
+		const float Ty = ToTargetY[Index];
+		const float Dot = ForwardX[Index] * Tx + ForwardY[Index] * Ty;
+		const float DistanceSquared = Tx * Tx + Ty * Ty;
+		OutArrived[Index] = ArrivalDistanceSquaredScalar >= DistanceSquared ||
+			(Dot <= 0.0f && PassDistanceSquaredScalar >= DistanceSquared);
+	}
+}
+
+namespace
+{
+	// Signed angle between the heading and the target in degrees, the way the vehicles steered before the kernel.
+	// The kernel classifies the same angle without Atan2.
+	float CalculateTurnAngle(const FVector& VehicleLocation, const FVector& VehicleForward,
+							 const FVector& TargetLocation)
+	{
+		// Get a normalized 2D Vector since the Z axis is not taken into account
+		FVector2D VehicleForward2D(VehicleForward);
+		VehicleForward2D.Normalize();
+
+		// Calculate 2D Vector to target location
+		FVector2D TargetVector2D(TargetLocation - VehicleLocation);
+		TargetVector2D.Normalize();
+
+		// Calculate orientation 0 - 180 for right, 0 - (-180) for left
+		const float Angle1 = FMath::Atan2(VehicleForward2D.X, VehicleForward2D.Y);
+		const float Angle2 = FMath::Atan2(TargetVector2D.X, TargetVector2D.Y);
+		float TurnAngle = FMath::RadiansToDegrees(Angle1 - Angle2);
+		if (TurnAngle > 180.0f)
+		{
+			TurnAngle -= 360.0f;
+		}
+		else if (TurnAngle < -180.0f)
+		{
+			TurnAngle += 360.0f;
+		}
+
+		return TurnAngle;
+	}
+
+	// Steering and arrival the way the vehicles were updated before the kernel, kept as the benchmark baseline
+	void CalculateTurnAngleReference(const TArray<FVector>& Forwards, const TArray<FVector>& ToTargets,
+									 const float ArrivalDistance, TArray<float>& OutSteering,
+									 TArray<uint8>& OutArrived)
+	{
+		for (int32 Index = 0; Index < Forwards.Num(); ++Index)
+		{
+			const float TurnAngle = CalculateTurnAngle(FVector::ZeroVector, Forwards[Index], ToTargets[Index]);
+
+			float Steering = 0.0f;
+			if (FMath::Abs(TurnAngle) < 1.0f)
+			{
+				Steering = 0.0f;
+			}
+			else if (TurnAngle < 45.0f)
+			{
+				Steering = 0.5f * FMath::Sign(TurnAngle);
+			}
+			else
+			{
+				Steering = FMath::Sign(TurnAngle);
+			}
+			OutSteering[Index] = Steering;
+			OutArrived[Index] = FVector2D(ToTargets[Index]).SizeSquared() <= FMath::Square(ArrivalDistance);
+		}
+	}
+
+	void BenchmarkSteering(const TArray<FString>& Args)
+	{
+		const int32 NumVehicles = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+		const int32 NumIterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 100;
+		constexpr float ArrivalDistance = 50.0f;
+
+		FRandomStream RandomStream(NumVehicles);
+		TArray<FVector> Forwards;
+		TArray<FVector> ToTargets;
+		TArray<float> ForwardX, ForwardY, ToTargetX, ToTargetY;
+		for (int32 Index = 0; Index < NumVehicles; ++Index)
+		{
+			const FVector Forward = RandomStream.GetUnitVector().GetSafeNormal2D();
+			const FVector ToTarget = RandomStream.GetUnitVector() * RandomStream.FRandRange(0.0f, 2000.0f);
+			Forwards.Add(Forward);
+			ToTargets.Add(ToTarget);
+			ForwardX.Add(Forward.X);
+			ForwardY.Add(Forward.Y);
+			ToTargetX.Add(ToTarget.X);
+			ToTargetY.Add(ToTarget.Y);
+		}
+
+		TArray<float> ReferenceSteering, ScalarSteering, KernelSteering;
+		TArray<uint8> ReferenceArrived, ScalarArrived, KernelArrived;
+		ReferenceSteering.SetNumZeroed(NumVehicles);
+		ScalarSteering.SetNumZeroed(NumVehicles);
+		KernelSteering.SetNumZeroed(NumVehicles);
+		ReferenceArrived.SetNumZeroed(NumVehicles);
+		ScalarArrived.SetNumZeroed(NumVehicles);
+		KernelArrived.SetNumZeroed(NumVehicles);
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			CalculateTurnAngleReference(Forwards, ToTargets, ArrivalDistance, ReferenceSteering, ReferenceArrived);
+		}
+		const double ReferenceTime = FPlatformTime::Seconds() - StartTime;
+
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			FTrafficSteeringKernel::CalculateScalar(ForwardX, ForwardY, ToTargetX, ToTargetY, ArrivalDistance,
+													ScalarSteering, ScalarArrived);
+		}
+		const double ScalarTime = FPlatformTime::Seconds() - StartTime;
+
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			FTrafficSteeringKernel::Calculate(ForwardX, ForwardY, ToTargetX, ToTargetY, ArrivalDistance,
+											  KernelSteering, KernelArrived);
+		}
+		const double KernelTime = FPlatformTime::Seconds() - StartTime;
+
+		// Pure pursuit with the targets as lookahead points, the vectorized path has to match the scalar one
+		constexpr float SteeringGain = 600.0f;
+		TArray<float> PursuitSteering;
+		PursuitSteering.SetNumZeroed(NumVehicles);
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			FTrafficSteeringKernel::CalculatePursuit(ForwardX, ForwardY, ToTargetX, ToTargetY, SteeringGain,
+													 PursuitSteering);
+		}
+		const double PursuitTime = FPlatformTime::Seconds() - StartTime;
+
+		// The Atan2 path may round differently right at the bucket borders, the scalar path has to match exactly
+		int32 NumReferenceMismatches = 0;
+		int32 NumScalarMismatches = 0;
+		for (int32 Index = 0; Index < NumVehicles; ++Index)
+		{
+			if (KernelSteering[Index] != ReferenceSteering[Index] || KernelArrived[Index] != ReferenceArrived[Index])
+				++NumReferenceMismatches;
+
+			if (KernelSteering[Index] != ScalarSteering[Index] || KernelArrived[Index] != ScalarArrived[Index])
+				++NumScalarMismatches;
+
+			const float ScalarPursuit = FTrafficSteeringKernel::CalculatePursuitSteering(
+				ForwardX[Index], ForwardY[Index], ToTargetX[Index], ToTargetY[Index], SteeringGain);
+			if (PursuitSteering[Index] != ScalarPursuit)
+				++NumScalarMismatches;
+		}
+
+		const double Scale = 1e9 / (static_cast<double>(NumVehicles) * NumIterations);
+		UE_LOG(LogTemp, Log, TEXT("Steering benchmark, %d vehicles x %d iterations:"), NumVehicles, NumIterations);
+		UE_LOG(LogTemp, Log, TEXT("  Atan2 reference: %.2f ns per vehicle"), ReferenceTime * Scale);
+		UE_LOG(LogTemp, Log, TEXT("  Scalar:          %.2f ns per vehicle"), ScalarTime * Scale);
+		UE_LOG(LogTemp, Log, TEXT("  Vectorized:      %.2f ns per vehicle, %.1fx faster than the reference"),
+			   KernelTime * Scale, KernelTime > 0.0 ? ReferenceTime / KernelTime : 0.0);
+		UE_LOG(LogTemp, Log, TEXT("  Pure pursuit:    %.2f ns per vehicle"), PursuitTime * Scale);
+		UE_LOG(LogTemp, Log, TEXT("  Mismatches: %d against the reference, %d against the scalar paths"),
+			   NumReferenceMismatches, NumScalarMismatches);
+	}
+}
+
+static FAutoConsoleCommand CTrafficBenchmarkSteering(
+	TEXT("Traffic.Benchmark.Steering"),
+	TEXT("Times the vectorized steering kernel against the scalar paths. Arguments: [NumVehicles] [NumIterations]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkSteering));
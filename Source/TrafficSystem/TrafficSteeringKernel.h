@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Steering and waypoint arrival for many vehicles at once. Inputs are the 2D forward vector of each vehicle and
+ * the 2D vector from the vehicle to its target, split into parallel component arrays.
+ *
+ * The heading error is classified with the cross and dot product of both vectors instead of two Atan2 calls, so
+ * nothing needs to be normalized. Four vehicles are processed per vector register, the remainder with the scalar
+ * path which gives the same results.
+ *
+ * Calculate quantizes the steering into straight, half and full lock. Vehicles steer with CalculatePursuit, which
+ * follows a point ahead on the lane with continuous steering; Calculate is kept as the benchmark baseline.
+ */
+struct TRAFFICSYSTEM_API FTrafficSteeringKernel
+{
+	static void Calculate(TArrayView<const float> ForwardX, TArrayView<const float> ForwardY,
+						  TArrayView<const float> ToTargetX, TArrayView<const float> ToTargetY,
+						  float ArrivalDistance, TArrayView<float> OutSteering, TArrayView<uint8> OutArrived);
+
+	static void CalculateScalar(TArrayView<const float> ForwardX, TArrayView<const float> ForwardY,
+								TArrayView<const float> ToTargetX, TArrayView<const float> ToTargetY,
+								float ArrivalDistance, TArrayView<float> OutSteering, TArrayView<uint8> OutArrived);
+
+	// Steering input for one vehicle, positive steers right
+	static float CalculateSteering(float ForwardX, float ForwardY, float ToTargetX, float ToTargetY);
+
+	// Pure pursuit: continuous steering along the arc through a lookahead point ahead on the lane. With a unit
+	// forward vector the arc has the curvature 2 * Cross / Distance^2, the steering is SteeringGain * Cross /
+	// Distance^2 clamped to full lock. Lookahead points behind the vehicle steer at full lock towards their side.
+	static void CalculatePursuit(TArrayView<const float> ForwardX, TArrayView<const float> ForwardY,
+								 TArrayView<const float> ToLookaheadX, TArrayView<const float> ToLookaheadY,
+								 float SteeringGain, TArrayView<float> OutSteering);
+
+	static float CalculatePursuitSteering(float ForwardX, float ForwardY, float ToLookaheadX, float ToLookaheadY,
+										  float SteeringGain);
+
+	// Targets within ArrivalDistance are reached, targets behind the vehicle already within PassDistance
+	static void CalculateArrivals(TArrayView<const float> ForwardX, TArrayView<const float> ForwardY,
+								  TArrayView<const float> ToTargetX, TArrayView<const float> ToTargetY,
+								  float ArrivalDistance, float PassDistance, TArrayView<uint8> OutArrived);
+};
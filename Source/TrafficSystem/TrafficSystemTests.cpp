@@ -0,0 +1,245 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+
+#include "LaneGraph.h"
+#include "LaneLandmarks.h"
+#include "LaneRoutePlanner.h"
+#include "TrafficBenchmarkCommandlet.h"
+#include "TrafficSimulationCore.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr int32 TestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter;
+
+	constexpr int32 RouteGridSize = 4;
+	constexpr int32 RouteSeed = 1337;
+	constexpr int32 NumRouteQueries = 64;
+	constexpr int32 NumLandmarks = 4;
+
+	constexpr int32 ReplayGridSize = 3;
+	constexpr int32 NumReplayVehicles = 60;
+	constexpr int32 NumWarmupSteps = 100;
+	constexpr int32 NumReplaySteps = 300;
+	constexpr float ReplayStepSeconds = 0.1f;
+
+	// Plain Dijkstra search as the reference for the planner, MAX_FLT if GoalNode can not be reached
+	float CalculateRouteCost(const FLaneGraph& Graph, const int32 StartNode, const int32 GoalNode)
+	{
+		struct FOpenNode
+		{
+			float Cost;
+			int32 Node;
+
+			bool operator<(const FOpenNode& Other) const
+			{
+				return Cost < Other.Cost;
+			}
+		};
+
+		TArray<float> Costs;
+		Costs.Init(MAX_FLT, Graph.GetNumNodes());
+		Costs[StartNode] = 0.0f;
+		TArray<FOpenNode> OpenHeap;
+		OpenHeap.HeapPush({ 0.0f, StartNode });
+		while (OpenHeap.Num() > 0)
+		{
+			FOpenNode Current;
+			OpenHeap.HeapPop(Current, false);
+			if (Current.Node == GoalNode)
+				return Current.Cost;
+
+			if (Current.Cost > Costs[Current.Node])
+				continue;
+
+			for (int32 Edge = Graph.OutOffsets[Current.Node]; Edge < Graph.OutOffsets[Current.Node + 1]; ++Edge)
+			{
+				const int32 Next = Graph.OutTargets[Edge];
+				const float NextCost = Current.Cost + Graph.OutCosts[Edge];
+				if (NextCost < Costs[Next])
+				{
+					Costs[Next] = NextCost;
+					OpenHeap.HeapPush({ NextCost, Next });
+				}
+			}
+		}
+
+		return MAX_FLT;
+	}
+
+	// Cost of the route along its edges, MAX_FLT if two nodes of it are not connected
+	float CalculateRouteCost(const FLaneGraph& Graph, const TArray<int32>& Route)
+	{
+		float Cost = 0.0f;
+		for (int32 RouteIndex = 1; RouteIndex < Route.Num(); ++RouteIndex)
+		{
+			const int32 Edge = Graph.FindEdge(Route[RouteIndex - 1], Route[RouteIndex]);
+			if (Edge == INDEX_NONE)
+				return MAX_FLT;
+
+			Cost += Graph.OutCosts[Edge];
+		}
+		return Cost;
+	}
+
+	bool TestRoute(FAutomationTestBase& Test, const FLaneGraph& Graph, const TCHAR* What, const int32 StartNode,
+				   const int32 GoalNode, const TArray<int32>& Route, const float ExpectedCost)
+	{
+		const FString Query = FString::Printf(TEXT("%s route from %d to %d"), What, StartNode, GoalNode);
+		if (!Test.TestTrue(Query + TEXT(" found"), Route.Num() > 0) ||
+			!Test.TestEqual(Query + TEXT(" start"), Route[0], StartNode) ||
+			!Test.TestEqual(Query + TEXT(" goal"), Route.Last(), GoalNode))
+			return false;
+
+		// Routes of equal cost can take different nodes, only the cost has to match
+		const float Cost = CalculateRouteCost(Graph, Route);
+		return Test.TestTrue(Query + TEXT(" follows the edges"), Cost != MAX_FLT) &&
+			Test.TestEqual(*(Query + TEXT(" cost")), Cost, ExpectedCost, ExpectedCost * KINDA_SMALL_NUMBER);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLaneGraphBuildTest, "TrafficSystem.LaneGraph.Build", TestFlags)
+
+bool FLaneGraphBuildTest::RunTest(const FString& Parameters)
+{
+	// A lane of three waypoints branching into two lanes of two waypoints that end in sinks, with a connection to a
+	// lane that does not exist
+	TArray<FLaneGraphLane> Lanes;
+	Lanes.SetNum(3);
+	for (const FVector& Location : { FVector(0, 0, 0), FVector(1000, 0, 0), FVector(2000, 0, 0) })
+	{
+		Lanes[0].Waypoints.AddDefaulted_GetRef().Location = Location;
+	}
+	for (const FVector& Location : { FVector(3000, 0, 0), FVector(4000, 0, 0) })
+	{
+		Lanes[1].Waypoints.AddDefaulted_GetRef().Location = Location;
+	}
+	for (const FVector& Location : { FVector(2000, 1000, 0), FVector(2000, 2000, 0) })
+	{
+		Lanes[2].Waypoints.AddDefaulted_GetRef().Location = Location;
+	}
+	Lanes[0].Waypoints[0].OutConnections.Add(FIntPoint(0, 1));
+	Lanes[0].Waypoints[1].OutConnections.Add(FIntPoint(0, 2));
+	Lanes[0].Waypoints[2].OutConnections = { FIntPoint(1, 0), FIntPoint(5, 0), FIntPoint(2, 0) };
+	Lanes[0].Waypoints[2].OutPriorities = { EConnectionPriority::Normal, EConnectionPriority::Normal,
+											EConnectionPriority::Yield };
+	Lanes[1].Waypoints[0].OutConnections.Add(FIntPoint(1, 1));
+	Lanes[2].Waypoints[0].OutConnections.Add(FIntPoint(2, 1));
+
+	FLaneGraph Graph;
+	FLaneGraph::Build(Lanes, Graph);
+
+	TestEqual(TEXT("Nodes"), Graph.GetNumNodes(), 7);
+	TestEqual(TEXT("Lanes"), Graph.GetNumLanes(), 3);
+	TestEqual(TEXT("Lane first nodes"), Graph.LaneFirstNodes, TArray<int32>({ 0, 3, 5 }));
+	TestEqual(TEXT("Node of a waypoint"), Graph.GetNodeIndex(2, 1), 6);
+	TestEqual(TEXT("Waypoint of a node"), Graph.GetWaypointIndex(4), 1);
+	TestEqual(TEXT("Node lanes"), Graph.NodeLanes, TArray<int32>({ 0, 0, 0, 1, 1, 2, 2 }));
+	TestEqual(TEXT("Node distance along the lane"), Graph.NodeDistances[2], 2000.0f);
+
+	TestEqual(TEXT("Out offsets"), Graph.OutOffsets, TArray<int32>({ 0, 1, 2, 4, 5, 5, 6, 6 }));
+	TestEqual(TEXT("Out targets"), Graph.OutTargets, TArray<int32>({ 1, 2, 3, 5, 4, 6 }));
+	TestEqual(TEXT("Out sources"), Graph.OutSources, TArray<int32>({ 0, 1, 2, 2, 3, 5 }));
+	TestEqual(TEXT("Edge length"), Graph.OutLengths[2], 1000.0f);
+	TestEqual(TEXT("Priority kept with its connection"), Graph.OutPriorities[3], EConnectionPriority::Yield);
+	TestEqual(TEXT("Found edge"), Graph.FindEdge(2, 5), 3);
+	TestEqual(TEXT("Missing edge"), Graph.FindEdge(5, 2), INDEX_NONE);
+
+	TestEqual(TEXT("In offsets"), Graph.InOffsets, TArray<int32>({ 0, 0, 1, 2, 3, 4, 5, 6 }));
+	TestEqual(TEXT("In sources"), Graph.InSources, TArray<int32>({ 0, 1, 2, 3, 2, 5 }));
+	TestEqual(TEXT("In costs"), Graph.InCosts[4], Graph.OutCosts[3]);
+
+	for (int32 Node = 0; Node < Graph.GetNumNodes(); ++Node)
+	{
+		TestEqual(*FString::Printf(TEXT("Node %d is a sink"), Node), Graph.GetNumOutEdges(Node) == 0,
+				  Node == 4 || Node == 6);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLaneRoutePlannerTest, "TrafficSystem.Routing.MatchesDijkstra", TestFlags)
+
+bool FLaneRoutePlannerTest::RunTest(const FString& Parameters)
+{
+	TArray<FLaneGraphLane> Lanes;
+	TArray<TArray<int32>> SignalNodes;
+	UTrafficBenchmarkCommandlet::BuildGrid(RouteGridSize, Lanes, SignalNodes);
+
+	FLaneGraph Graph;
+	FLaneGraph::Build(Lanes, Graph);
+	FLaneLandmarks Landmarks;
+	FLaneLandmarks::Build(Graph, NumLandmarks, Landmarks);
+	if (!TestTrue(TEXT("Landmarks fit the graph"), Landmarks.IsCompatible(Graph)))
+		return false;
+
+	// The grid has no sinks and turns into every lane, every node reaches every other one
+	FLaneRoutePlanner Planner;
+	FRandomStream Stream(RouteSeed);
+	TArray<int32> Route;
+	for (int32 Query = 0; Query < NumRouteQueries; ++Query)
+	{
+		const int32 StartNode = Stream.RandHelper(Graph.GetNumNodes());
+		const int32 GoalNode = Stream.RandHelper(Graph.GetNumNodes());
+		const float Cost = CalculateRouteCost(Graph, StartNode, GoalNode);
+		if (!TestTrue(FString::Printf(TEXT("Node %d reaches %d"), StartNode, GoalNode), Cost != MAX_FLT))
+			continue;
+
+		Planner.FindRoute(Graph, StartNode, GoalNode, Route);
+		TestRoute(*this, Graph, TEXT("A*"), StartNode, GoalNode, Route, Cost);
+
+		Planner.FindRoute(Graph, StartNode, GoalNode, Route, &Landmarks);
+		TestRoute(*this, Graph, TEXT("ALT"), StartNode, GoalNode, Route, Cost);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrafficReplayTest, "TrafficSystem.Simulation.Replay", TestFlags)
+
+bool FTrafficReplayTest::RunTest(const FString& Parameters)
+{
+	TArray<FLaneGraphLane> Lanes;
+	TArray<TArray<int32>> SignalNodes;
+	UTrafficBenchmarkCommandlet::BuildGrid(ReplayGridSize, Lanes, SignalNodes);
+
+	const TSharedRef<FLaneGraph, ESPMode::ThreadSafe> Graph = MakeShared<FLaneGraph, ESPMode::ThreadSafe>();
+	FLaneGraph::Build(Lanes, *Graph);
+
+	FTrafficSimulationCore Simulation;
+	Simulation.Initialize(Graph);
+	UTrafficBenchmarkCommandlet::AddGridSignals(SignalNodes, Simulation);
+	for (int32 Vehicle = 0; Vehicle < NumReplayVehicles; ++Vehicle)
+	{
+		const int32 Lane = Vehicle % Graph->GetNumLanes();
+		const int32 WaypointIndex = (Vehicle / Graph->GetNumLanes()) % Graph->LaneNumNodes[Lane];
+		Simulation.AddVehicle(Graph->GetNodeIndex(Lane, WaypointIndex));
+	}
+
+	// Snapshot in the middle of a run, with vehicles queued at signals and holding slots
+	for (int32 Step = 0; Step < NumWarmupSteps; ++Step)
+	{
+		Simulation.Step(ReplayStepSeconds);
+	}
+
+	TestTrue(TEXT("Replay from a snapshot matches the recorded run"),
+			 UTrafficBenchmarkCommandlet::VerifyReplay(Simulation, NumReplaySteps, ReplayStepSeconds));
+
+	// A snapshot of another graph is rejected
+	TArray<uint8> Snapshot;
+	Simulation.SaveSnapshot(Snapshot);
+	const TSharedRef<FLaneGraph, ESPMode::ThreadSafe> OtherGraph = MakeShared<FLaneGraph, ESPMode::ThreadSafe>();
+	UTrafficBenchmarkCommandlet::BuildGrid(ReplayGridSize + 1, Lanes, SignalNodes);
+	FLaneGraph::Build(Lanes, *OtherGraph);
+	FTrafficSimulationCore OtherSimulation;
+	OtherSimulation.Initialize(OtherGraph);
+	AddExpectedError(TEXT("different lane graph"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse(TEXT("Snapshot loads into another graph"), OtherSimulation.LoadSnapshot(Snapshot));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrafficVehicleState.h"
+
+#include "TrafficSerialization.h"
+
+int32 FTrafficVehicleState::Num() const
+{
+	return Handles.Num();
+}
+
+int32 FTrafficVehicleState::Add(const int32 Handle, const int32 TargetNode)
+{
+	const int32 Index = Handles.Add(Handle);
+	TargetNodes.Add(TargetNode);
+	PreviousNodes.Add(INDEX_NONE);
+	Routes.AddDefaulted();
+	RouteCursors.Add(0);
+	RandomStreams.AddDefaulted();
+	RouteTickets.Add(INDEX_NONE);
+	Locations.Add(FVector::ZeroVector);
+	Forwards.Add(FVector::ForwardVector);
+	PreviousLocations.Add(FVector::ZeroVector);
+	InterpolationTimes.Add(0.0f);
+	Speeds.Add(0.0f);
+	KinematicFlags.Add(0);
+	LODTiers.Add(ETrafficLODTier::Full);
+	WakeFlags.Add(0);
+	Signals.Add(INDEX_NONE);
+	SignalDelays.Add(0.0f);
+	StoppedNodes.Add(INDEX_NONE);
+	SimulationOwnedFlags.Add(0);
+	PoolSlots.Add(INDEX_NONE);
+	PendingDeltaTimes.Add(0.0f);
+	HeightOffsets.Add(0.0f);
+	LaneDistances.Add(0.0f);
+	Leaders.Add(INDEX_NONE);
+	LeaderGaps.Add(MAX_FLT);
+	DesiredSpeeds.Add(0.0f);
+	Gaps.Add(MAX_FLT);
+	ApproachingRates.Add(0.0f);
+	Accelerations.Add(0.0f);
+	Steering.Add(0.0f);
+	Throttle.Add(0.0f);
+	Brake.Add(1.0f);
+
+	return Index;
+}
+
+void FTrafficVehicleState::RemoveAtSwap(const int32 Index)
+{
+	check(Handles.IsValidIndex(Index));
+
+	Handles.RemoveAtSwap(Index, 1, false);
+	TargetNodes.RemoveAtSwap(Index, 1, false);
+	PreviousNodes.RemoveAtSwap(Index, 1, false);
+	Routes.RemoveAtSwap(Index, 1, false);
+	RouteCursors.RemoveAtSwap(Index, 1, false);
+	RandomStreams.RemoveAtSwap(Index, 1, false);
+	RouteTickets.RemoveAtSwap(Index, 1, false);
+	Locations.RemoveAtSwap(Index, 1, false);
+	Forwards.RemoveAtSwap(Index, 1, false);
+	PreviousLocations.RemoveAtSwap(Index, 1, false);
+	InterpolationTimes.RemoveAtSwap(Index, 1, false);
+	Speeds.RemoveAtSwap(Index, 1, false);
+	KinematicFlags.RemoveAtSwap(Index, 1, false);
+	LODTiers.RemoveAtSwap(Index, 1, false);
+	WakeFlags.RemoveAtSwap(Index, 1, false);
+	Signals.RemoveAtSwap(Index, 1, false);
+	SignalDelays.RemoveAtSwap(Index, 1, false);
+	StoppedNodes.RemoveAtSwap(Index, 1, false);
+	SimulationOwnedFlags.RemoveAtSwap(Index, 1, false);
+	PoolSlots.RemoveAtSwap(Index, 1, false);
+	PendingDeltaTimes.RemoveAtSwap(Index, 1, false);
+	HeightOffsets.RemoveAtSwap(Index, 1, false);
+	LaneDistances.RemoveAtSwap(Index, 1, false);
+	Leaders.RemoveAtSwap(Index, 1, false);
+	LeaderGaps.RemoveAtSwap(Index, 1, false);
+	DesiredSpeeds.RemoveAtSwap(Index, 1, false);
+	Gaps.RemoveAtSwap(Index, 1, false);
+	ApproachingRates.RemoveAtSwap(Index, 1, false);
+	Accelerations.RemoveAtSwap(Index, 1, false);
+	Steering.RemoveAtSwap(Index, 1, false);
+	Throttle.RemoveAtSwap(Index, 1, false);
+	Brake.RemoveAtSwap(Index, 1, false);
+}
+
+void FTrafficVehicleState::Reset()
+{
+	Handles.Reset();
+	TargetNodes.Reset();
+	PreviousNodes.Reset();
+	Routes.Reset();
+	RouteCursors.Reset();
+	RandomStreams.Reset();
+	RouteTickets.Reset();
+	Locations.Reset();
+	Forwards.Reset();
+	PreviousLocations.Reset();
+	InterpolationTimes.Reset();
+	Speeds.Reset();
+	KinematicFlags.Reset();
+	LODTiers.Reset();
+	WakeFlags.Reset();
+	Signals.Reset();
+	SignalDelays.Reset();
+	StoppedNodes.Reset();
+	SimulationOwnedFlags.Reset();
+	PoolSlots.Reset();
+	PendingDeltaTimes.Reset();
+	HeightOffsets.Reset();
+	LaneDistances.Reset();
+	Leaders.Reset();
+	LeaderGaps.Reset();
+	DesiredSpeeds.Reset();
+	Gaps.Reset();
+	ApproachingRates.Reset();
+	Accelerations.Reset();
+	Steering.Reset();
+	Throttle.Reset();
+	Brake.Reset();
+}
+
+void FTrafficVehicleState::Serialize(FArchive& Ar)
+{
+	// Routes are the only arrays with allocations per vehicle
+	TrafficSerialization::SerializeArray(Ar, Handles);
+	TrafficSerialization::SerializeArray(Ar, TargetNodes);
+	TrafficSerialization::SerializeArray(Ar, PreviousNodes);
+	Ar << Routes;
+	TrafficSerialization::SerializeArray(Ar, RouteCursors);
+	TrafficSerialization::SerializeArray(Ar, RandomStreams);
+	TrafficSerialization::SerializeArray(Ar, RouteTickets);
+	TrafficSerialization::SerializeArray(Ar, Locations);
+	TrafficSerialization::SerializeArray(Ar, Forwards);
+	TrafficSerialization::SerializeArray(Ar, PreviousLocations);
+	TrafficSerialization::SerializeArray(Ar, InterpolationTimes);
+	TrafficSerialization::SerializeArray(Ar, Speeds);
+	TrafficSerialization::SerializeArray(Ar, KinematicFlags);
+	TrafficSerialization::SerializeArray(Ar, LODTiers);
+	TrafficSerialization::SerializeArray(Ar, WakeFlags);
+	TrafficSerialization::SerializeArray(Ar, Signals);
+	TrafficSerialization::SerializeArray(Ar, SignalDelays);
+	TrafficSerialization::SerializeArray(Ar, StoppedNodes);
+	TrafficSerialization::SerializeArray(Ar, SimulationOwnedFlags);
+	TrafficSerialization::SerializeArray(Ar, PoolSlots);
+	TrafficSerialization::SerializeArray(Ar, PendingDeltaTimes);
+	TrafficSerialization::SerializeArray(Ar, HeightOffsets);
+	TrafficSerialization::SerializeArray(Ar, LaneDistances);
+	TrafficSerialization::SerializeArray(Ar, Leaders);
+	TrafficSerialization::SerializeArray(Ar, LeaderGaps);
+	TrafficSerialization::SerializeArray(Ar, DesiredSpeeds);
+	TrafficSerialization::SerializeArray(Ar, Gaps);
+	TrafficSerialization::SerializeArray(Ar, ApproachingRates);
+	TrafficSerialization::SerializeArray(Ar, Accelerations);
+	TrafficSerialization::SerializeArray(Ar, Steering);
+	TrafficSerialization::SerializeArray(Ar, Throttle);
+	TrafficSerialization::SerializeArray(Ar, Brake);
+}
@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Simulation detail of a vehicle, from every frame with physics to virtual
+enum class ETrafficLODTier : uint8
+{
+	Full,
+	Reduced,
+	Kinematic,
+	Virtual,
+	Num
+};
+
+/**
+ * Driving state of all simulated vehicles stored as parallel arrays. Every array has the same length and
+ * is indexed by the dense vehicle index, which changes when vehicles are removed (swap removal).
+ */
+struct TRAFFICSYSTEM_API FTrafficVehicleState
+{
+	// Stable handle of the vehicle stored at each index
+	TArray<int32> Handles;
+
+	// Lane graph node the vehicle is currently driving to, INDEX_NONE when it has none
+	TArray<int32> TargetNodes;
+
+	// Node the vehicle came from to its target, INDEX_NONE before it reached its first one
+	TArray<int32> PreviousNodes;
+
+	// Planned route and the index of the target node in it, empty when the vehicle picks branches at random
+	TArray<TArray<int32>> Routes;
+	TArray<int32> RouteCursors;
+
+	// Picks branches for vehicles without a route, one stream per vehicle keeps the choices independent of the
+	// update order
+	TArray<FRandomStream> RandomStreams;
+
+	// Ticket of the route query the vehicle is waiting for, INDEX_NONE if there is none
+	TArray<int32> RouteTickets;
+
+	// Transform gathered at the start of each update
+	TArray<FVector> Locations;
+	TArray<FVector> Forwards;
+
+	// Location before the last move of a kinematic vehicle and the time the move covered. The actor is drawn
+	// between the two over as long, so vehicles updated every few steps move as smoothly as the others.
+	TArray<FVector> PreviousLocations;
+	TArray<float> InterpolationTimes;
+
+	// Speed along the forward vector
+	TArray<float> Speeds;
+
+	// Non-zero for vehicles moved along the lane graph without physics, see UTrafficSimulationSubsystem
+	TArray<uint8> KinematicFlags;
+
+	TArray<ETrafficLODTier> LODTiers;
+
+	// Non-zero for vehicles updated in the next frame regardless of their tier, set when the signal they are
+	// subscribed to changes. Vehicles subscribe to the signal governing their target node, INDEX_NONE without one.
+	TArray<uint8> WakeFlags;
+	TArray<int32> Signals;
+
+	// Time spent stopped in front of the subscribed signal, see FTrafficSignalMetrics
+	TArray<float> SignalDelays;
+
+	// Node of a stop connection the vehicle came to a full stop in front of, INDEX_NONE otherwise
+	TArray<int32> StoppedNodes;
+
+	// Non-zero for virtual vehicles created by the simulation, they only have an actor while one is borrowed
+	// from the pool at PoolSlots, which is INDEX_NONE otherwise
+	TArray<uint8> SimulationOwnedFlags;
+	TArray<int32> PoolSlots;
+
+	// Time since the last update of the vehicle, its tier decides how often it is updated
+	TArray<float> PendingDeltaTimes;
+
+	// Height of the actor above the lane graph, kept while moving kinematically
+	TArray<float> HeightOffsets;
+
+	// Distance along the lane of the target node, see FLaneOccupancy
+	TArray<float> LaneDistances;
+
+	// Vehicle ahead on the lane graph and the distance to it, INDEX_NONE and MAX_FLT without one
+	TArray<int32> Leaders;
+	TArray<float> LeaderGaps;
+
+	// Car following inputs and result: desired speed at the target, bumper to bumper gap to the closest
+	// obstacle (vehicle ahead or stop), closing speed towards it and the resulting acceleration
+	TArray<float> DesiredSpeeds;
+	TArray<float> Gaps;
+	TArray<float> ApproachingRates;
+	TArray<float> Accelerations;
+
+	// Inputs computed by the update and pushed to the movement components
+	TArray<float> Steering;
+	TArray<float> Throttle;
+	TArray<float> Brake;
+
+	int32 Num() const;
+	int32 Add(int32 Handle, int32 TargetNode);
+	void RemoveAtSwap(int32 Index);
+	void Reset();
+
+	// Writes or reads all arrays, see FTrafficSimulationCore::SaveSnapshot
+	void Serialize(FArchive& Ar);
+};
@@ -137,6 +137,11 @@ void FTrafficSystemEdMode::RenderLane(ALane* Lane, FPrimitiveDrawInterface* PDI)
     if (!Lane || !PDI)
         return;
 
+    // Spline lanes are drawn along their sampled curve
+    TArray<FVector> Points;
+    TArray<int32> WaypointPoints;
+    Lane->TessellateLane(Points, WaypointPoints);
+
     for (int WaypointIndex = 0; WaypointIndex < Lane->GetWaypoints().Num(); ++WaypointIndex)
     {
         // Render Waypoint as arrow
@@ -148,10 +153,11 @@ void FTrafficSystemEdMode::RenderLane(ALane* Lane, FPrimitiveDrawInterface* PDI)
         // Render edges between waypoints
         if (WaypointIndex > 0)
         {
-            const auto& FromWaypoint = Lane->GetWaypointByIndex(WaypointIndex - 1);
-            const auto& ToWaypoint = Lane->GetWaypointByIndex(WaypointIndex);
             PDI->SetHitProxy(new HLaneWaypointEdgeHitProxy(Lane, WaypointIndex - 1, WaypointIndex));
-            PDI->DrawLine(FromWaypoint.Location, ToWaypoint.Location, FLinearColor::Green, SDPG_Foreground);
+            for (int Point = WaypointPoints[WaypointIndex - 1]; Point < WaypointPoints[WaypointIndex]; ++Point)
+            {
+                PDI->DrawLine(Points[Point], Points[Point + 1], FLinearColor::Green, SDPG_Foreground);
+            }
             PDI->SetHitProxy(nullptr);
         }
 